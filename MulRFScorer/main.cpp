@@ -16,6 +16,7 @@
 #include "tree_LCA_mapping.h"
 #include "tree_name_map.h"
 #include "tree_duplication.h"
+#include "tree_induced.h"
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 #include "boost/tuple/tuple.hpp"
@@ -39,6 +40,7 @@ int main(int ac, char* av[]) {
     std::string trees_filename;    
     std::string output_filename;
     bool stree_first = true;
+    bool check = false;
     
     {
         Argument a; a.add(ac, av);
@@ -47,6 +49,7 @@ int main(int ac, char* av[]) {
             MSG("options:");
             MSG("  -i [ --input ] arg      input trees (file in NEWICK format)");
             MSG("  -o [ --output ] arg     write the trees into a file");
+            MSG("       --check            score every input tree again on a rooted copy of the species tree");
             MSG("  -h [ --help ]           produce help message");
             MSG("");
             MSG("example:");
@@ -59,6 +62,8 @@ int main(int ac, char* av[]) {
         
         // output file
         if (a.existArgVal2("-o", "--output", output_filename)) MSG("output file: " << output_filename);
+        // compare the scores with compute_rf_score
+        check = a.existArg("--check");
         
         
                 
@@ -80,9 +85,7 @@ int main(int ac, char* av[]) {
     aw::Tree s_tree;
     aw::idx2name s_taxa;
     std::vector<aw::Tree> g_trees;
-    std::vector<aw::Tree> rs_trees;
     std::vector<aw::idx2name> g_taxa;
-    std::vector<aw::LCAmapping> s_lmaps;
     aw::TreetaxaMap s_nmap;
     std::vector<aw::LCA> g_lca;
     std::vector<float> g_weights;
@@ -242,32 +245,14 @@ int main(int ac, char* av[]) {
             }
     }
 
-    {   //Root Supertree + define initial LCA leaf Mapping
-        s_lmaps.clear();
-        s_lmaps.resize(g_trees.size());
-        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            rs_trees.push_back(s_tree);
-            s_lmaps[i].update_LCA_leaves(g_nmaps[i],s_nmap,g_trees[i],rs_trees[i]);
-            std::vector<unsigned int> ch;
-            unsigned int g_rt;
-            g_trees[i].adjacent(0,ch);
-            if(g_trees[i].is_leaf(ch[0])) g_rt = ch[0]; else g_rt = ch[1];
-            ch.clear();
-            unsigned int ggid = g_nmaps[i].gid(g_rt);
-            s_nmap.ids(ggid,ch);
-            unsigned int s_id;
-            BOOST_FOREACH(const unsigned int &c,ch)
-                if(s_lmaps[i].mapping(c)==g_rt) {
-                    s_id = c;   break;  }
-            rs_trees.back().rootBy(s_id);
-        }
-    }
+    aw::InducedTrees s_induced;     //the supertree restricted to the taxa of the input trees
+    s_induced.create(g_nmaps);
 
-    std::vector<unsigned int> rs_int_nodes;  //internal nodes in each rs_tree
+    std::vector<unsigned int> rs_int_nodes;  //internal nodes of the supertree restricted to each input tree
     rs_int_nodes.clear();
-    {   //store internal nodes count for each rs_tree
+    {   //store internal nodes count for each input tree
         unsigned int temp;
-        for (unsigned int k=0; k<rs_trees.size(); ++k) {
+        for (unsigned int k=0; k<g_trees.size(); ++k) {
             temp = g_nmaps[k].unq_leaves() - 2;
             BOOST_FOREACH(const gid2ctype::value_type &w, gid2cnt) {
                 unsigned int ggid = w.first;
@@ -278,26 +263,6 @@ int main(int ac, char* av[]) {
         }
     }
 
-    {   //Computing cluster size for supertrees: computed based on leaf mapping
-        unsigned int count;
-        for (unsigned int k=0, kEE=rs_trees.size(); k<kEE; ++k){
-            TREE_POSTORDER2(v,rs_trees[k]) {
-                if (!rs_trees[k].is_leaf(v.idx)) {
-                    count = 0;
-                    BOOST_FOREACH(const unsigned int &c,rs_trees[k].children(v.idx,v.parent))
-                        count = count + rs_trees[k].return_clstSz(c);
-                    rs_trees[k].update_clst(v.idx,count);
-                }
-                else {
-                    unsigned int gid = s_nmap.gid(v.idx);
-                    if(s_lmaps[k].mapping(v.idx)!=NONODE)    //:FOR MUL-TREES
-                        rs_trees[k].update_clst(v.idx,1);
-                    else rs_trees[k].update_clst(v.idx,0);
-                }
-            }
-        }
-    }
-
     {   g_lca.clear();  //store lca if it is done first time
         aw::LCA lca;
         for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
@@ -307,16 +272,41 @@ int main(int ac, char* av[]) {
 
     std::vector<float> g_scr;
     float scr = 0.0f;
-    {   for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
-            s_lmaps[i].update_LCA_internals(g_lca[i],rs_trees[i]);
+    {   s_induced.update(s_tree,s_nmap);
         for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            std::pair<unsigned int,unsigned int> p = g_nodes[i];
-            g_scr.push_back(aw::compute_rf_score(rs_trees[i],g_trees[i],s_lmaps[i],p,rs_int_nodes[i],g_weights[i]));
+            g_scr.push_back(s_induced.rf_score(i,g_trees[i],g_nmaps[i],g_lca[i],g_nodes[i],rs_int_nodes[i])*g_weights[i]);
             scr = scr + g_scr[i] ;
         }
         MSG_nonewline("\nMulRF Score: "<<std::fixed<<std::setprecision(2)<<scr);
     }
 
+    if (check) {    //every score again with compute_rf_score on a rooted copy of the species tree
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+            aw::Tree rs_tree = s_tree;
+            aw::LCAmapping s_lmap;
+            s_lmap.update_LCA_leaves(g_nmaps[i],s_nmap,g_trees[i],rs_tree);
+            std::vector<unsigned int> ch;
+            g_trees[i].adjacent(0,ch);
+            const unsigned int g_rt = g_trees[i].is_leaf(ch[0]) ? ch[0] : ch[1];
+            ch.clear();
+            s_nmap.ids(g_nmaps[i].gid(g_rt),ch);
+            BOOST_FOREACH(const unsigned int &c,ch)
+                if(s_lmap.mapping(c)==g_rt) { rs_tree.rootBy(c);  break; }
+            TREE_POSTORDER2(v,rs_tree) {
+                if (!rs_tree.is_leaf(v.idx)) {
+                    unsigned int count = 0;
+                    BOOST_FOREACH(const unsigned int &c,rs_tree.children(v.idx,v.parent))
+                        count = count + rs_tree.return_clstSz(c);
+                    rs_tree.update_clst(v.idx,count); }
+                else rs_tree.update_clst(v.idx,s_lmap.mapping(v.idx)!=NONODE ? 1 : 0);
+            }
+            s_lmap.update_LCA_internals(g_lca[i],rs_tree);
+            const float ref = aw::compute_rf_score(rs_tree,g_trees[i],s_lmap,g_nodes[i],rs_int_nodes[i],g_weights[i]);
+            if (ref!=g_scr[i]) ERROR_exit("Gene Tree "<<i<<": MulRF Score "<<g_scr[i]<<" but compute_rf_score gives "<<ref);
+        }
+        MSG("\nScores checked with compute_rf_score: "<<g_trees.size()<<" input trees");
+    }
+
     {   //preprocessing of s_tree
         BOOST_FOREACH(const gid2ctype::value_type &w, gid2cnt) {
             unsigned int ggid = w.first;
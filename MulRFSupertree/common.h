@@ -7,34 +7,47 @@
 #include <cstdlib>
 //#include "rmq.c"
 
+#ifdef WITH_MPI
+#include <mpi.h>
+// rank of this process, set by par::init after MPI_Init
+inline int &mpi_rank() {
+    static int r = 0;
+    return r;
+}
+#endif
+
 // stream for normal messages
 class StdOut {
     private: std::ofstream log_file;
 
-    public: StdOut(const bool &logging_) : logging(logging_) {
-        quiet = false;
+    private: bool log_open;
+
+    // the log is opened with the first message, when the MPI rank is known
+    private: bool open_log() {
+        if (!logging) return false;
         #ifdef WITH_MPI
-        if (mpi_rank == 0)
+        if (mpi_rank() != 0) return false;
         #endif
-        if (logging) log_file.open("data_log.txt");
+        if (!log_open) log_file.open("data_log.txt");
+        log_open = true;
+        return true;
+    }
+
+    public: StdOut(const bool &logging_) : logging(logging_) {
+        quiet = false;
+        log_open = false;
     }
 
     public: inline StdOut& operator<<(std::ostream& (*r)(std::ostream&))
     {
         if (!quiet) std::cout << r;
-        #ifdef WITH_MPI
-        if (mpi_rank == 0)
-        #endif
-        if (logging) log_file << r;
+        if (open_log()) log_file << r;
         return *this;
     }
 
     public: template<class T> inline StdOut& operator<<(const T &r) {
         if (!quiet) std::cout << r;
-        #ifdef WITH_MPI
-        if (mpi_rank == 0)
-        #endif
-        if (logging) log_file << r;
+        if (open_log()) log_file << r;
         return *this;
     }
     
@@ -53,7 +66,7 @@ class StdErr {
     private: bool open_log() {
         if (!logging) return false;
         #ifdef WITH_MPI
-        if (mpi_rank == 0)
+        if (mpi_rank() == 0)
         #endif
         if (!log_open) log_file.open("data_log_error.txt");
         log_open = true;
@@ -68,7 +81,7 @@ class StdErr {
 {
         std::cerr << r;
         #ifdef WITH_MPI
-        if (mpi_rank == 0)
+        if (mpi_rank() == 0)
         #endif
         if (open_log()) log_file << r;
         return *this;
@@ -78,7 +91,7 @@ class StdErr {
 {
         std::cerr << r;
         #ifdef WITH_MPI
-        if (mpi_rank == 0)
+        if (mpi_rank() == 0)
         #endif
         if (open_log()) log_file << r;
         return *this;
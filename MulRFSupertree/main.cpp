@@ -20,6 +20,8 @@
 #include "tree_node_distance.h"
 #include "tree_duplication.h"
 #include "rf_compute.h"
+#include "parallel.h"
+#include "spr_search.h"
 #include <boost/foreach.hpp>
 #include <boost/progress.hpp>
 #include "boost/tuple/tuple.hpp"
@@ -32,242 +34,73 @@
 static const unsigned int NONODE = UINT_MAX;
 long double EPSILON = 0.00001;
 
-struct chEdge { unsigned int x, y, px; };
-
 typedef boost::unordered_map<unsigned int,int> gid2ctype;
 
-/*
- * 
- */
-int main(int ac, char* av[]) {
-    {
-        std::ostringstream os; os << "command:";
-        for (int i = 0; i < ac; i++) os << ' ' << av[i];
-        MSG(os.str());
-    }
-    std::string trees_filename;
-    std::string c_filename;
-    bool stree_first = false;
-    std::string output_filename;    
-    bool alltrees = false;
-    bool initialtree = false;
-    bool inputrees = false;
-    bool constr = false;    
-    unsigned int seed = std::time(0);
-    unsigned int SPR_rounds = 0; 
-    {
-        Argument a; a.add(ac, av);
-        // help
-        if (a.existArg2("-h","--help")) {
-            MSG("options:");
-            MSG("  -i [ --input ] arg      input trees (file in NEWICK format)");
-            MSG("       --stree            first input tree is a starting species tree");
-            MSG("  -c [--constraints] arg   constraints");
-            MSG("  -o [ --output ] arg     write the trees into a file (file in NEWICK format)");
-            MSG("       --alltrees         synonym for --initialtree and --inputrees");
-            MSG("       --initialtree      output the initial species tree");
-            MSG("       --inputrees        output the input trees");            
-            MSG("       --seed arg         random generator seed");            
-            MSG("  -h [ --help ]           produce help message");
-            MSG("");
-            MSG("example:");
-            MSG("  " << av[0] << " -i inputF.newick -o outputF.newick");
-            exit(0);
-        }
-        
-        // input trees
-        if (a.existArgVal2("-i", "--input", trees_filename)) MSG("input file: " << trees_filename) else MSG("using standard input");
-        // starting species tree
-        stree_first = a.existArg("--stree");
-        // constraints 
-        if (a.existArgVal2("-c","--constraints", c_filename)) {
-            MSG("constraints file: " << c_filename);
-            constr = true;
-        }        
-        if(constr && stree_first)  WARNING("Constraints doesn't work with starting species tree!");
-      
-        // output file
-        if (a.existArgVal2("-o", "--output", output_filename)) MSG("output file: " << output_filename);
-        // output initial species tree
-        initialtree = a.existArg("--initialtree");
-        // output gene trees
-        inputrees = a.existArg("--inputrees");        
-        // output all trees
-        alltrees = a.existArg("--alltrees");
-        if (alltrees) {
-            inputrees = true;
-            initialtree = true;
-        }
-        // random seed
-        a.existArgVal("--seed", seed);
-        MSG("seed: " << seed);
-        aw::rng.seed(static_cast<unsigned int>(seed));
-        // unknown arguments?
-        a.unusedArgsError();
-    }
-    // -----------------------------------------------------------------------------------
-
-    int t3 = clock();
-
-    //create output stream
-    std::ofstream ouput_fs;
-    if (!output_filename.empty()) {
-        ouput_fs.open(output_filename.c_str());
-        if (!ouput_fs) ERROR_exit("cannot write file '" << output_filename << "'");
-    }
-    std::ostream &output = output_filename.empty() ? std::cout : ouput_fs;
-
-    // read trees
-    // output:
-    aw::Tree s_tree;
+// parsed input trees and everything derived from them that does not depend on
+// the search; shared read only by all searches
+struct SearchInput {
+    bool stree_first, constr, initialtree;
+    aw::Tree s_tree;                    //starting species tree (--stree)
     aw::idx2name s_taxa;
-    std::vector<aw::Tree> g_trees;
-    std::vector<std::vector<std::string> > c_taxa;
-    std::vector<aw::Tree> rs_trees;
-    std::vector<aw::idx2name> g_taxa;    
-    std::vector<aw::LCAmapping> s_lmaps;
     aw::TreetaxaMap s_nmap;
-    std::vector<aw::LCA> g_lca;
+    std::vector<aw::Tree> g_trees;
     std::vector<float> g_weights;
-    {
-        // read trees -------------------------------------
-        {
-            const std::string filename = trees_filename;
-            std::ifstream ifs;
-            std::istream &is = filename.empty() ? std::cin : ifs;
-            if (!filename.empty()) {
-                ifs.open(filename.c_str());
-                if (!ifs) ERROR_exit("cannot read file '" << filename << "'");
-            }
-            if (stree_first) {
-                float t_w = 1.0f;  //we will not use this weight
-                if (!aw::stream2tree(is, s_tree, s_taxa,t_w)) ERROR_exit("No species tree found in file '" << filename << "'");
-            }
-            MSG_nonewline("Reading input trees: ");
-            aw::gauge_exp g; aw::gauge_init(&g);
-            for (;;) {
-                aw::Tree t;
-                aw::idx2name t_names;
-                float t_w = 1.0f;
-                if (!aw::stream2tree(is, t, t_names,t_w)) break;
-                g_taxa.push_back(t_names);
-                g_trees.push_back(t);
-                g_weights.push_back(t_w);
-                aw::gauge_inc(&g);
-            }
-            aw::gauge_end(&g);
-            MSG("Input trees: " << g_trees.size());
-            if (g_trees.empty()) ERROR_exit("No input trees found in file '" << filename << "'");
-         }
-
-        // reading constriants file ----------------------------
-         if (constr) {   
-            std::ifstream ifs;
-            std::istream &is = c_filename.empty() ? std::cin : ifs;
-            if (!c_filename.empty()) {
-                ifs.open(c_filename.c_str());
-                if (!ifs) ERROR_exit("cannot read file '" << c_filename << "'");
-            }                        
-            for (;;) {
-                std::vector<std::string> constr_list;
-                if (!aw::stream2constr(is, constr_list)) break;
-                if(constr_list.size()<=1)
-                    ERROR_exit("Too small constraint!");
-                c_taxa.push_back(constr_list);
-            }
-
-            MSG("Constraints: " << c_taxa.size());
-            if (c_taxa.empty()) ERROR_exit("No constraints found in file '" << c_filename << "'");
-        }       
-    }
-
-    if (stree_first) { // check input for binary        
-            TREE_FOREACHNODE(v,s_tree) {
-                const unsigned int d = s_tree.degree(v);
-                bool isroot = false;
-                if(s_tree.is_rooted()) isroot = (s_tree.root == v);
-                else isroot = (0 == v);
-                if (d == 0) continue; // single isolated node
-                if ((d == 1) && (!isroot)) continue; // leaf
-                if ((d == 3) && (!isroot)) continue; // binary interior node but not root
-                if ((d == 2) && isroot) continue; // root node with children
-                ERROR_exit("Initial species tree"<<" is not binary");
-            }
-        MSG("Initial species tree pass binary test");
-    }
-
-    // map taxa labels
+    std::vector<std::vector<std::string> > c_taxa;
     aw::TaxaMap taxamap;  //to store all taxon and global id
-    std::vector<aw::TreetaxaMap> g_nmaps; //for mapping taxamap and idx2name (of a tree)    
-    {
-        g_nmaps.resize(g_taxa.size());
-        for (unsigned int i=0,iEE=g_taxa.size(); i<iEE; ++i) {
-            aw::idx2name &n = g_taxa[i];
-            taxamap.insert(n);
-            g_nmaps[i].create(n,taxamap);
-        }
-        MSG("Taxa: " << taxamap.size());
-    }
-  
-    // checking constraints
+    std::vector<aw::TreetaxaMap> g_nmaps; //for mapping taxamap and idx2name (of a tree)
     boost::unordered_map<unsigned int, unsigned int> gid2c; //<global id, order of its list>
-    {       
-        for (unsigned int i=0,iEE=c_taxa.size(); i<iEE; ++i) {
-            std::vector<std::string> ls = c_taxa[i];
-            BOOST_FOREACH(const std::string &st,ls) {
-                if(!taxamap.exist(st))
-                    ERROR_exit("Constraints error, unique taxa: "<<st);
-                unsigned int gid = taxamap.gid(st);
-
-                if(gid2c.find(gid) == gid2c.end())
-                    gid2c.insert(std::pair<unsigned int,unsigned int>(gid,i));
-                else
-                    ERROR_exit("Constraints error, overlap!");                
-            }                         
-        }        
-    }
-   
     std::vector<std::pair<unsigned int,unsigned int> > g_nodes;  //pair <internal node,leaf count>
-    std::vector<unsigned int> root_leaf;    
-    { // gene tree nodes
-        unsigned int c = 0, t = 0, t1 = 0, c1 = 0;
-        for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k){
-            bool first = true;
-            TREE_PREORDER2(v,g_trees[k]) {
-                ++c;                
-                if (g_trees[k].is_leaf(v.idx)) {
-                    ++t;                  
-                    if(first) { root_leaf.push_back(g_nmaps[k].gid(v.idx)); first = false; }  
-                }
-            }
-            if(g_trees[k].degree(0)>2) ++c;
-            t1 +=t; c1 +=c;
-            g_nodes.push_back(std::pair<unsigned int,unsigned int>(c-t-1,t));            
-            t = 0; c = 0;
-        }
-        MSG("Input tree nodes: " << c1 << " (" << t1 << " taxa)");
-    }
+    std::vector<unsigned int> root_leaf;
+    gid2ctype gid2cnt;    //<gid,count>
+    std::vector<aw::LCA> g_lca;         //LCAs of the input trees as given (leaf adding)
+    std::vector<aw::LCA> g_leaf_lca;    //LCAs of the input trees rooted by their root leaf
+};
+
+// the supertree found by one search, ready for output
+struct SearchResult {
+    aw::Tree s_tree;
+    aw::idx2name s_taxa;
+    aw::TreetaxaMap s_nmap;
+    std::vector<aw::Tree> g_trees;      //input trees, rooted as the search left them
+    std::vector<unsigned int> g_scr;
+    float score;
+    unsigned int SPR_rounds;
+    std::string initial_tree;           //with --initialtree
+};
 
+/*
+ * One supertree search: leaf adding (unless a starting tree is given) followed by
+ * SPR neighborhood searches until there is no improvement. All random choices are
+ * drawn from rng, so searches with their own generators can run side by side.
+ * With rank_edges every MPI process takes its share of the prune edges of a round.
+ * With multi_moves the best moves of several prune edges can be applied in one round.
+ * With dup_filter only that many prune edges of a round, those with the lowest gene
+ * duplication change, are scored exactly; a round without improvement is completed with
+ * the others.
+ */
+void search_supertree(SearchInput &in, boost::mt19937 &rng, const bool parallel_edges, const bool rank_edges, const bool multi_moves,
+        const unsigned int dup_filter, const bool verbose, SearchResult &res) {
+    const bool stree_first = in.stree_first, constr = in.constr;
+    std::vector<float> &g_weights = in.g_weights;
+    std::vector<std::vector<std::string> > &c_taxa = in.c_taxa;
+    aw::TaxaMap &taxamap = in.taxamap;
+    std::vector<aw::TreetaxaMap> &g_nmaps = in.g_nmaps;
+    boost::unordered_map<unsigned int, unsigned int> &gid2c = in.gid2c;
+    std::vector<std::pair<unsigned int,unsigned int> > &g_nodes = in.g_nodes;
+    std::vector<unsigned int> &root_leaf = in.root_leaf;
+    gid2ctype &gid2cnt = in.gid2cnt;
+
+    //state of this search
+    aw::Tree &s_tree = res.s_tree;
+    aw::idx2name &s_taxa = res.s_taxa;
+    aw::TreetaxaMap &s_nmap = res.s_nmap;
+    std::vector<aw::Tree> &g_trees = res.g_trees;
     if (stree_first) {
-        aw::idx2name &n = s_taxa;
-        if(n.size()<taxamap.size())  ERROR_exit("Error: Initial species tree doesn't have all leaves!!");
-        taxamap.insert(n);
-        s_nmap.create(n,taxamap);        
-    }
-
-    //counting maximum number of copies of a gene node in a genetree
-    gid2ctype gid2cnt;    //<gid,count>    
-    {
-        for(unsigned int i=0,iKK=taxamap.size(); i<iKK; ++i) gid2cnt[i]=0;
-        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            TREE_FOREACHLEAF(v,g_trees[i]) {
-                unsigned int gid_v = g_nmaps[i].gid(v);
-                int gid_cnt = g_nmaps[i].ids_count(gid_v);
-                if(gid2cnt[gid_v] < gid_cnt) gid2cnt[gid_v] = gid_cnt;
-        }   }
-        for(unsigned int i=0,iKK=taxamap.size(); i<iKK; ++i)
-          if(gid2cnt[i]==0) ERROR_exit("Error: Some leaf of the supertree is not in any of the input trees!!");
-    }
+        s_tree = in.s_tree; s_taxa = in.s_taxa; s_nmap = in.s_nmap; }
+    g_trees = in.g_trees;
+    aw::InducedTrees s_induced;     //the supertree restricted to the taxa of the input trees
+    unsigned int SPR_rounds = 0;
+    unsigned int multi_applied = 0;     //rounds that applied more than one move
 
     int cst[c_taxa.size()];  //FOR CONSTRAINTS.... to store each clades's root node in the species tree
     for(unsigned int i=0; i<c_taxa.size(); ++i)
@@ -275,17 +108,19 @@ int main(int ac, char* av[]) {
       
     // build starting tree using leaf adding ************************************************************************************************
     if (!stree_first) {        
-        int t1 = clock();
+        const double t1 = par::wtime();
         
-        MSG("Building initial species tree...");
+        if(verbose) MSG("Building initial species tree...");
         std::vector<unsigned int> s_inodes,g_inodes;  //internal node in s_tree, g_tree
+        std::vector<aw::LCAmapping> s_lmaps;
+        std::vector<aw::LCA> &g_lca = in.g_lca;
         std::queue<unsigned int> taxa_queue;
 
         if(true) { // random taxa order
             std::vector<unsigned int> nodes; nodes.reserve(taxamap.size());
             for (unsigned int i=0,iEE=taxamap.size(); i<iEE; ++i) nodes.push_back(i);
             boost::uniform_int<> range(0,nodes.size()-1);
-            boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(aw::rng, range);
+            boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(rng, range);
             for (unsigned int i=0,iEE=nodes.size(); i<iEE; ++i) {
                 const unsigned int j=die();
                 util::swap(nodes[i],nodes[j]);
@@ -419,9 +254,11 @@ int main(int ac, char* av[]) {
         }
         
         std::vector< aw::TreeClusters<aw::Tree> > s_clst; s_clst.resize(g_trees.size());
+        aw::ClusterIndex s_index;   //one traversal of s_tree for the clusters of all input trees
+        s_index.create(s_tree,s_tree.root,NONODE);
         //updating s_tree cluster + s_inodes
         for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            s_clst[i].create(s_tree,g_trees[i],g_nmaps[i],s_nmap,s_lmaps[i]);
+            s_clst[i].create(s_tree,g_trees[i],g_nmaps[i],s_nmap,s_lmaps[i],s_index);
             unsigned int inodes = 0;
             TREE_POSTORDER2(v,s_tree) {
                 unsigned int count = 0;
@@ -433,19 +270,20 @@ int main(int ac, char* av[]) {
             s_inodes.push_back(inodes);
         }
 
-        std::vector<unsigned int> g_scr;
+        std::vector<unsigned int> g_scr(g_trees.size());
         float scr = 0;
-        {   aw::LCA lca;
-            for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {                
-                lca.create(g_trees[i]);
-                g_lca.push_back(lca);    // compute LCAs for the input tree
-                s_lmaps[i].update_LCA_internals(g_lca[i],s_tree); }
+        {   for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+                s_lmaps[i].update_LCA_internals(g_lca[i],s_tree);
+                g_scr[i] = aw::compute_rf_score(s_tree,g_trees[i],s_lmaps[i],s_clst[i],g_inodes[i],s_inodes[i]); }
         }        
         
         // precompute parents
         aw::SubtreeParent<aw::Tree> s_parent; s_parent.create(s_tree);
         std::vector<aw::SubtreeParent<aw::Tree> > g_parents(g_trees.size());
         for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k) g_parents[k].create(g_trees[k]);        
+        std::vector<aw::DfsStep> steps;         //move-down positions of the new leaf
+        std::vector<aw::EdgeMove> move_log;     //moves made in the move-down
+        aw::LeafInsertion insertion;            //score changes of the move-down steps
 
         //Adding remaning leaves-----------------------------------------------------------------------------------------
         while(taxa_queue.size()!=0) { 
@@ -470,12 +308,14 @@ int main(int ac, char* av[]) {
                 s_taxa.insert(aw::idx2name::value_type(c, taxamap.taxon(gid))); }            
 
             s_tree.add_edge(c,p);  unsigned int old_root = s_tree.root;            
+            unsigned int below_p = old_root;     //the other child of p
             
             if(constr && gid2c.find(gid) != gid2c.end() && cst[gid2c[gid]] != NONODE) {  //if new gid should go in an existing cade               
                 gid_list = gid2c[gid];
                 unsigned int clade_rt = cst[gid_list];
                 unsigned int p_clade_rt = s_parent.parent(clade_rt);                
                 s_tree.remove_edge(clade_rt,p_clade_rt); s_tree.add_edge(clade_rt,p); s_tree.add_edge(p_clade_rt,p);                
+                below_p = clade_rt;
                 s_parent.update(clade_rt,p); s_parent.update(p,p_clade_rt); s_parent.update(c,p);   //update parents
                 in_clade = true;
             }
@@ -493,19 +333,24 @@ int main(int ac, char* av[]) {
                     s_parent.update(sids[s],c);
             s_parent.tPtrUpdate(s_tree);            
 
+            //only the input trees with the gid see the new leaf: for all others the new nodes
+            //are unmapped and have no cluster, and p maps like the node below it
+            std::vector<unsigned int> has;
+            for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k)
+                if(g_nmaps[k].exists(gid)) has.push_back(k);
+
             //update LCAs
             if(!in_clade){               
-                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {                   
+                #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+                for (unsigned int i=0; i<g_trees.size(); ++i) {
                     if(g_nmaps[i].exists(gid)){
                         //updating s_inodes number...
                         std::vector<unsigned int> gids;
                         g_nmaps[i].ids(gid,gids);
-                        if(gids.size()>1) {  //updating number of internal nodes in the new s copies
-                            unsigned int old_s = s_inodes[i]; s_inodes.erase(s_inodes.begin()+i); s_inodes.insert(s_inodes.begin()+i,old_s+2);
-                        }
-                        else {
-                            unsigned int old_s = s_inodes[i]; s_inodes.erase(s_inodes.begin()+i); s_inodes.insert(s_inodes.begin()+i,old_s+1);
-                        }                        
+                        if(gids.size()>1)  //updating number of internal nodes in the new s copies
+                            s_inodes[i] += 2;
+                        else
+                            s_inodes[i] += 1;
                         
                         //mapping leaf nodes...
                         unsigned int j=0;
@@ -530,7 +375,12 @@ int main(int ac, char* av[]) {
                 }
             }
             else { //when the leaf was NOT added above root
-                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+                //only c, p and the ancestors of p have other subtrees now
+                std::vector<unsigned int> path, changed;
+                changed.push_back(c); changed.push_back(p);
+                aw::with_ancestors(s_parent,changed,path);
+                #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+                for (unsigned int i=0; i<g_trees.size(); ++i) {
                     if(!g_nmaps[i].exists(gid)){
                         if(sids.size()>1)
                             for(unsigned int s=0; s<sids.size(); ++s)
@@ -539,20 +389,14 @@ int main(int ac, char* av[]) {
                         unsigned int clade_rt = cst[gid_list];
                         s_lmaps[i].set_LCA(p, s_lmaps[i].mapping(clade_rt));
                     }
-                    else {  //we will have to do all mapping etc from scratch now
+                    else {  //we will have to redo the mapping of the changed path now
                         //updating s_inodes number...
                         std::vector<unsigned int> gids;
                         g_nmaps[i].ids(gid,gids);
-                        if(gids.size()>1) {  //updating number of internal nodes in the new s copies
-                            unsigned int old_s = s_inodes[i];
-                            s_inodes.erase(s_inodes.begin()+i);
-                            s_inodes.insert(s_inodes.begin()+i,old_s+2);
-                        }
-                        else {
-                            unsigned int old_s = s_inodes[i];
-                            s_inodes.erase(s_inodes.begin()+i);
-                            s_inodes.insert(s_inodes.begin()+i,old_s+1);
-                        }                        
+                        if(gids.size()>1)  //updating number of internal nodes in the new s copies
+                            s_inodes[i] += 2;
+                        else
+                            s_inodes[i] += 1;
                         //mapping leaf nodes...
                         unsigned int j=0;
                         for(unsigned int k=0; k<sids.size(); ++k){ // map some leaves and leave others...
@@ -562,19 +406,27 @@ int main(int ac, char* av[]) {
                                 s_lmaps[i].set_LCA(sids[k],NONODE);
                         }
                         //mapping internal nodes...
-                        s_lmaps[i].update_LCA_internals(g_lca[i],s_tree);
+                        s_lmaps[i].update_LCA_internals(g_lca[i],s_tree,s_parent,path);
                     }
                 }
             }
             
 
             //Updating clusters for s_tree & input trees + g_inodes
-            for (unsigned int k=0, kEE=g_trees.size(); k<kEE; ++k) {
+            s_index.create(s_tree,s_tree.root,NONODE);
+            #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+            for (unsigned int k=0; k<g_trees.size(); ++k) {
+                if(!g_nmaps[k].exists(gid)) {
+                    BOOST_FOREACH(const unsigned int &l, sids) s_clst[k].update(l,0);
+                    s_clst[k].update(c,0);
+                    s_clst[k].update(p,s_clst[k].cluster(below_p));
+                    continue;
+                }
                 //redoing clusters for s_tree
-                s_clst[k].create(s_tree,g_trees[k],g_nmaps[k],s_nmap,s_lmaps[k]);
+                s_clst[k].create(s_tree,g_trees[k],g_nmaps[k],s_nmap,s_lmaps[k],s_index);
 
                 //clusters for gene trees + g_inodes
-                if(g_nmaps[k].exists(gid)) {
+                {
                     unsigned int inodes = 0;
                     TREE_POSTORDER2(v,g_trees[k]) {
                         if(g_trees[k].is_leaf(v.idx)) {
@@ -589,34 +441,42 @@ int main(int ac, char* av[]) {
                             if(ncount>1) ++inodes;
                         }
                     }
-                    g_inodes.erase(g_inodes.begin()+k);
                     if(inodes>0) inodes--;                    
-                    g_inodes.insert(g_inodes.begin()+k,inodes);
+                    g_inodes[k] = inodes;
                 }
             }            
 
-            {   g_scr.clear();  scr = 0;
-                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {                    
-                    g_scr.push_back(aw::compute_rf_score(s_tree,g_trees[i],s_lmaps[i],s_clst[i],g_inodes[i],s_inodes[i]));
+            {   scr = 0;     //the other scores stay as they are
+                #pragma omp parallel for schedule(dynamic,16) if(par::worth(has.size(),2))
+                for (unsigned int j=0; j<has.size(); ++j) {
+                    const unsigned int i = has[j];
+                    g_scr[i] = aw::compute_rf_score(s_tree,g_trees[i],s_lmaps[i],s_clst[i],g_inodes[i],s_inodes[i]); }
+                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
                     scr = scr + g_scr[i]*g_weights[i] ;
-                }
             }
          
             unsigned int subtree = c;
             unsigned int psubtree = s_parent.parent(subtree);
-            aw::Tree best_tree = s_tree, rnd_tree = s_tree;
             float best_score = scr;
             unsigned int itr_start = s_parent.sibling_binary(subtree);
             unsigned int itr_par = psubtree;
+            //the best tree is s_tree after the first best_moves moves of the log, best_above
+            //is then the parent of psubtree. The move-down itself only adds up the score
+            //changes of its steps, s_tree is moved once to the best position afterwards.
+            unsigned int best_moves = 0, best_above = NONODE;
+            move_log.clear();
+            aw::dfs_steps(s_tree,itr_start,itr_par,steps);
+            insertion.create(s_tree,s_parent,steps,p,c,below_p,has,g_trees,g_nmaps,s_nmap,s_lmaps,s_clst,g_lca);
             unsigned int last_node = NONODE;
 
             //MOVE DOWN LOOP..............................
-            for (aw::Tree::iterator_dfs m=rnd_tree.begin_dfs(itr_start,itr_par),mEE=rnd_tree.end_dfs(); m!=mEE; ++m) {                
+            for (unsigned int si=0,siEE=steps.size(); si<siEE; ++si) {
+                const aw::DfsStep &m = steps[si];
                 if(m.idx == itr_start) {
-                    if(constr && !in_clade && rnd_tree.constr_num(m.idx)!=NONODE)  break;                   
+                    if(constr && !in_clade && s_tree.constr_num(m.idx)!=NONODE)  break;                   
                     continue;  }
                                 
-                if(rnd_tree.is_fake(m.parent)) continue;  //FOR MULTree
+                if(s_tree.is_fake(m.parent)) continue;  //FOR MULTree
 
                 if(constr && !in_clade && last_node==NONODE && s_tree.constr_num(m.parent) != NONODE)  {
                     last_node = m.parent;
@@ -626,72 +486,51 @@ int main(int ac, char* av[]) {
                 if(constr && !in_clade && last_node == m.idx) last_node = NONODE;
                 if(constr && !in_clade && last_node != NONODE)  continue;                
                 float rf_new = 0, rf_old = 0;
+                for (unsigned int ti=insertion.first[si],tiEE=insertion.first[si+1]; ti<tiEE; ++ti) {
+                    const aw::InsertTerms &t = insertion.terms[ti];
+                    rf_old += t.par_old*g_weights[t.tree];
+                    rf_old += t.pm_old*g_weights[t.tree];
+                    rf_new += t.par_new*g_weights[t.tree];
+                    rf_new += t.pm_new*g_weights[t.tree];
+                }
 
                 switch (m.direction) {
                     case aw::PREORDER: {
                         if(constr && !in_clade && s_tree.constr_num(m.idx) != NONODE)  last_node = m.idx;
-                        
-                        for (unsigned int n=0,nEE=g_trees.size(); n<nEE; ++n) {
-                            unsigned int old_par_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], psubtree, s_parent.parent(psubtree), s_clst[n]);                            
-                            rf_old += old_par_score*g_weights[n];
-                            unsigned int old_pm_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], m.parent, psubtree, s_clst[n]);                            
-                            rf_old += old_pm_score*g_weights[n];                        }
-                        aw::move2edge_binary(s_tree, subtree, psubtree, m.idx, m.parent);
-                        s_parent.update(m.parent,s_parent.parent(psubtree));
-                        s_parent.update(psubtree,m.parent);
-                        s_parent.update(m.idx,psubtree);
-                        s_parent.tPtrUpdate(s_tree);
-
-                        for (unsigned int n=0,nEE=g_trees.size(); n<nEE; ++n) {                            
-                             s_lmaps[n].set_LCA(m.parent, s_lmaps[n].mapping(psubtree));                             
-                             unsigned int subt_map = s_lmaps[n].mapping(subtree);
-                             unsigned int midx_map = s_lmaps[n].mapping(m.idx);                             
-                             s_lmaps[n].set_LCA(psubtree, g_lca[n].lca(subt_map, midx_map));                             
-                             s_clst[n].update(m.parent,s_clst[n].cluster(psubtree));                             
-                             s_clst[n].update(psubtree,s_clst[n].cluster(m.idx)+s_clst[n].cluster(subtree));                             
-                             unsigned int new_par_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], psubtree, m.parent, s_clst[n]);
-                             rf_new += new_par_score*g_weights[n];
-                             unsigned int new_pm_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], m.parent, s_parent.parent(m.parent), s_clst[n]);                             
-                             rf_new += new_pm_score*g_weights[n];
-                        }
+                        {   aw::EdgeMove e; e.v = m.idx; e.pv = m.parent; e.ppv = NONODE; e.down = true;
+                            move_log.push_back(e); }
                         scr = scr - (rf_old - rf_new);
                         if(fabs(best_score-scr) > EPSILON){
                             best_score = scr;
-                            best_tree = s_tree;                            
+                            best_moves = move_log.size(); best_above = m.parent;
                         }
                     } break;
                     case aw::POSTORDER: {                       
-                        
-                        for (unsigned int n=0,nEE=g_trees.size(); n<nEE; ++n) {
-                            unsigned int old_par_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], psubtree, s_parent.parent(psubtree), s_clst[n]);
-                            rf_old += old_par_score*g_weights[n];
-                            unsigned int old_pm_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], m.parent, s_parent.parent(m.parent), s_clst[n]);
-                            rf_old += old_pm_score*g_weights[n];
-                        }
-                        aw::REVmove2edge_binary(s_tree, subtree, psubtree, m.idx, m.parent, s_parent.parent(m.parent));
-                        s_parent.update(psubtree,s_parent.parent(m.parent));
-                        s_parent.update(m.parent,psubtree);
-                        s_parent.update(m.idx,m.parent);
-                        s_parent.tPtrUpdate(s_tree);
-
-                        for (unsigned int n=0,nEE=g_trees.size(); n<nEE; ++n) {
-                             s_lmaps[n].set_LCA(psubtree, s_lmaps[n].mapping(m.parent));
-                             unsigned int m_map = s_lmaps[n].mapping(m.idx);
-                             unsigned int subsib_map = s_lmaps[n].mapping(s_parent.sibling_binary(m.idx));
-                             s_lmaps[n].set_LCA(m.parent, g_lca[n].lca(m_map, subsib_map));
-                             s_clst[n].update(psubtree,s_clst[n].cluster(m.parent));
-                             s_clst[n].update(m.parent,s_clst[n].cluster(m.idx)+s_clst[n].cluster(s_parent.sibling_binary(m.idx)));
-                             unsigned int new_par_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], psubtree,  s_parent.parent(psubtree), s_clst[n]);
-                             rf_new += new_par_score*g_weights[n];
-                             unsigned int new_pm_score = aw::compute_rf_score(s_tree, g_trees[n], s_lmaps[n], m.parent, psubtree, s_clst[n]);
-                             rf_new += new_pm_score*g_weights[n];
-                        }
+                        //the parent of m.parent while psubtree is below it; below_p has that of psubtree
+                        {   aw::EdgeMove e; e.v = m.idx; e.pv = m.parent; e.down = false;
+                            e.ppv = s_parent.parent(m.parent==itr_start ? psubtree : m.parent);
+                            move_log.push_back(e); }
                         scr = scr - (rf_old - rf_new);
                     } break;
                     default: break;
                 }
             }
-            s_tree = best_tree;
+            //only p and the nodes above it, where p was and where it is now, changed; the
+            //move-down keeps p above below_p, so these are all above p or best_above now
+            std::vector<unsigned int> path;
+            {   std::vector<unsigned int> ends;
+                ends.push_back(p); ends.push_back(below_p);
+                if(best_above!=NONODE) ends.push_back(best_above);
+                aw::with_ancestors(s_parent,ends,path);
+            }
+            std::vector<int> g_change(g_trees.size(),0);
+            #pragma omp parallel for schedule(dynamic,16) if(par::worth(has.size(),2))
+            for (unsigned int j=0; j<has.size(); ++j) {
+                const unsigned int k = has[j];
+                BOOST_FOREACH(const unsigned int &v, path)
+                    g_change[k] -= aw::rf_score_node(s_tree,g_trees[k],s_lmaps[k],s_clst[k],v,s_parent.parent(v));
+            }
+            aw::replay_moves(s_tree,subtree,psubtree,move_log,best_moves);
             s_parent.create(s_tree);                        
 
             if(constr) {
@@ -707,21 +546,31 @@ int main(int ac, char* av[]) {
                 }               
             }
        
-            s_clst.clear(); s_clst.resize(g_trees.size());
-            for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
-                s_clst[i].create(s_tree,g_trees[i],g_nmaps[i],s_nmap,s_lmaps[i]);
-
-            {   float scr1 = 0; g_scr.clear();
-                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)                   
-                    s_lmaps[i].update_LCA_internals(g_lca[i],s_tree); 
-                for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) { 
-                    g_scr.push_back(aw::compute_rf_score(s_tree,g_trees[i],s_lmaps[i],s_clst[i],g_inodes[i],s_inodes[i]));
-                    scr1 = scr1 + g_scr[i]*g_weights[i] ;
+            {   std::vector<unsigned int> nodes;    //the changed nodes, children before parents
+                aw::with_ancestors(s_parent,path,nodes);
+                unsigned int b = NONODE;
+                BOOST_FOREACH(const unsigned int &ch, s_tree.children(p,s_parent.parent(p)))
+                    if(ch!=c) b = ch;
+                #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+                for (unsigned int k=0; k<g_trees.size(); ++k) {
+                    if(!g_nmaps[k].exists(gid)) {   //p only stands in for its other child
+                        s_lmaps[k].set_LCA(p,s_lmaps[k].mapping(b));
+                        s_clst[k].update(p,s_clst[k].cluster(b));
+                        continue;
+                    }
+                    BOOST_FOREACH(const unsigned int &v, nodes) {
+                        if(s_tree.is_leaf(v)) continue;
+                        unsigned int sz = 0;
+                        BOOST_FOREACH(const unsigned int &ch, s_tree.children(v,s_parent.parent(v)))
+                            sz += s_clst[k].cluster(ch);
+                        s_clst[k].update(v,sz);
+                    }
+                    s_lmaps[k].update_LCA_internals(g_lca[k],s_tree,s_parent,nodes);
+                    BOOST_FOREACH(const unsigned int &v, nodes)
+                        g_change[k] += aw::rf_score_node(s_tree,g_trees[k],s_lmaps[k],s_clst[k],v,s_parent.parent(v));
+                    g_scr[k] += g_change[k];
                 }
-            
-                //if(fabs(scr1 - best_score) > EPSILON) ERROR_exit("Scores doesn't match!!");
-
-            }          
+            }
         }        
 
         s_tree.rootInit();
@@ -745,9 +594,9 @@ int main(int ac, char* av[]) {
             }            
         }
       
-        int t2 = clock();
-        {
-            long ttime = ((long)(t2-t1))/CLOCKS_PER_SEC;
+        const double t2 = par::wtime();
+        if(verbose) {
+            long ttime = (long)(t2-t1);
             int d, h, m, s;
             util::convertTime(ttime,d,h,m,s);
 
@@ -776,7 +625,8 @@ int main(int ac, char* av[]) {
     }
 
     // Write the tree in the output file if asked for
-    if (initialtree) {
+    if (in.initialtree) {
+        std::ostringstream output;
         output << "[ Initial Species Tree ]" << std::endl;        
 
         {   //preprocessing of s_tree
@@ -798,6 +648,7 @@ int main(int ac, char* av[]) {
             }            
             aw::tree2newick(output,temp_stree,s_taxa); output << std::endl;
         }
+        res.initial_tree = output.str();
     }
 
     {   // root the trees by one leaf
@@ -807,45 +658,18 @@ int main(int ac, char* av[]) {
         }
     }
 
-    {   //Calculate cluster size for input trees
-        unsigned int count;
+    {   //Calculate cluster size for input trees; kept up to date when they are rooted again
         for (unsigned int k=0; k<g_trees.size(); ++k)
-            TREE_POSTORDER2(v,g_trees[k]) {
-                if (g_trees[k].is_leaf(v.idx))
-                    g_trees[k].update_clst(v.idx,1);
-                else {  count = 0;
-                    BOOST_FOREACH(const unsigned int &c,g_trees[k].children(v.idx,v.parent))
-                        count = count + g_trees[k].return_clstSz(c);
-                    g_trees[k].update_clst(v.idx,count); }
-            }
+            aw::gene_clusters(g_trees[k]);
     }
     
-    {   //Root Supertree + define initial LCA leaf Mapping
-        s_lmaps.clear();
-        s_lmaps.resize(g_trees.size());
-        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            rs_trees.push_back(s_tree);
-            s_lmaps[i].update_LCA_leaves(g_nmaps[i],s_nmap,g_trees[i],rs_trees[i]);
-            std::vector<unsigned int> ch;
-            unsigned int g_rt;  //g_tree root leaf
-            g_trees[i].adjacent(0,ch);
-            if(g_trees[i].is_leaf(ch[0])) g_rt = ch[0]; else g_rt = ch[1];
-            ch.clear();
-            unsigned int ggid = g_nmaps[i].gid(g_rt);
-            s_nmap.ids(ggid,ch);
-            unsigned int s_id;
-            BOOST_FOREACH(const unsigned int &c,ch)
-                if(s_lmaps[i].mapping(c)==g_rt) {
-                    s_id = c;   break;  }
-            rs_trees.back().rootBy(s_id);            
-        }
-    }
+    s_induced.create(g_nmaps);
     
-    std::vector<unsigned int> rs_int_nodes;  //internal nodes in each rs_tree
+    std::vector<unsigned int> rs_int_nodes;  //internal nodes of the supertree restricted to each input tree
     rs_int_nodes.clear();
-    {   //store internal nodes count for each rs_tree
+    {   //store internal nodes count for each input tree
         unsigned int temp;
-        for (unsigned int k=0; k<rs_trees.size(); ++k) {
+        for (unsigned int k=0; k<g_trees.size(); ++k) {
             temp = g_nmaps[k].unq_leaves() - 2;
             BOOST_FOREACH(const gid2ctype::value_type &w, gid2cnt) {
                 unsigned int ggid = w.first;
@@ -856,43 +680,28 @@ int main(int ac, char* av[]) {
         }
     }
 
-    {   //Computing cluster size for supertrees: computed based on leaf mapping
-        unsigned int count;
-        for (unsigned int k=0, kEE=rs_trees.size(); k<kEE; ++k){
-            TREE_POSTORDER2(v,rs_trees[k]) {
-                if (!rs_trees[k].is_leaf(v.idx)) {
-                    count = 0;
-                    BOOST_FOREACH(const unsigned int &c,rs_trees[k].children(v.idx,v.parent))
-                        count = count + rs_trees[k].return_clstSz(c);
-                    rs_trees[k].update_clst(v.idx,count);                    
-                }
-                else {
-                    unsigned int gid = s_nmap.gid(v.idx);
-                    if(s_lmaps[k].mapping(v.idx)!=NONODE)    //:FOR MUL-TREES
-                        rs_trees[k].update_clst(v.idx,1);
-                    else rs_trees[k].update_clst(v.idx,0);                    
-                }
-            }
-        }
-    }
-   
-    {   g_lca.clear();  //store lca if it is done first time
-        aw::LCA lca;
-        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            lca.create(g_trees[i]);
-            g_lca.push_back(lca); }
+    std::vector<aw::RootedLCA> g_lca;   //LCA queries for the current rootings of the input trees
+    {   for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+            g_lca.push_back(aw::RootedLCA(in.g_leaf_lca[i]));
+            g_lca.back().update_root(g_trees[i]); }
     }
 
     std::vector<unsigned int> g_scr;
-    float scr = 0;
-    {   for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
-            s_lmaps[i].update_LCA_internals(g_lca[i],rs_trees[i]);
-        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-            std::pair<unsigned int,unsigned int> p = g_nodes[i];
-            g_scr.push_back(aw::compute_rf_score(rs_trees[i],g_trees[i],s_lmaps[i],p,rs_int_nodes[i]));            
-            scr = scr + g_scr[i]*g_weights[i] ;
-        }
-        MSG_nonewline("\nCurrent RF Score: "<<std::fixed<<std::setprecision(2)<< scr);
+    aw::SPRInput spr_input(s_tree,s_nmap,g_nmaps,g_nodes,rs_int_nodes,g_weights,g_scr,constr);
+    {   const unsigned int left = spr_input.fold(g_trees);
+        if(verbose && left<g_trees.size()) MSG("Input trees left for the search: "<<left); }
+    aw::DupFilter dups;
+    if(dup_filter) {
+        dups.create(spr_input,in.g_trees,dup_filter);
+        if(verbose) MSG("Input trees for the duplication prefilter: "<<dups.size());
+    }
+
+    float scr = 0;
+    {   s_induced.update(s_tree,s_nmap);
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
+            g_scr.push_back(s_induced.rf_score(i,g_trees[i],g_nmaps[i],g_lca[i],g_nodes[i],rs_int_nodes[i]));
+        scr = aw::weighted_score(g_scr,g_weights);
+        if(verbose) MSG_nonewline("\nCurrent RF Score: "<<std::fixed<<std::setprecision(2)<< scr);
     }
 
     aw::Tree bestTree = s_tree; //to store best tree in one SPR neighborhood
@@ -902,10 +711,10 @@ int main(int ac, char* av[]) {
     for(;;)
     {
         SPR_rounds++;
-        std::vector<bool> treeEft;
+        spr_input.update();
         unsigned int lost_node = NONODE;
         unsigned int x, px, y;
-        std::vector<struct chEdge> spr_edge;   //round robin
+        std::vector<aw::chEdge> spr_edge;   //round robin
 
         //s_tree is not changed in any way -- CLADES are preserved....
         //Starting unrooted SPR....
@@ -926,17 +735,17 @@ int main(int ac, char* av[]) {
                 case aw::POSTORDER: {  continue; } break;
                 default: {continue;} break;
             }
-            chEdge a;            
+            aw::chEdge a;            
             a.x = x; a.px = px; a.y = y;
             spr_edge.push_back(a);
         }
 
         //for randomization
         boost::uniform_int<> range(0,spr_edge.size()-1);
-        boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(aw::rng, range);
+        boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(rng, range);
         for (unsigned int i=0,iEE=spr_edge.size(); i<iEE; ++i) {
             const unsigned int j=die();
-            chEdge temp;
+            aw::chEdge temp;
             temp = spr_edge[i];
             spr_edge[i] = spr_edge[j];
             spr_edge[j] = temp;
@@ -947,362 +756,176 @@ int main(int ac, char* av[]) {
         if(spr_side==1)
             reg_x = false;
 
+        //prune edges in the order they are searched: (edge, regraft side)
+        std::vector<std::pair<unsigned int,bool> > spr_order;
         for(int sd = 0; sd<2; ++sd) {
-            for (unsigned int qi=0,qiEE=spr_edge.size(); qi<qiEE; ++qi) {
-                x = spr_edge[qi].x; y = spr_edge[qi].y; px = spr_edge[qi].px;               
+            for (unsigned int qi=0,qiEE=spr_edge.size(); qi<qiEE; ++qi)
+                spr_order.push_back(std::make_pair(qi,reg_x));
+            reg_x = !reg_x;
+        }
 
-                aw::Tree us_tree = s_tree;
-                us_tree.delRoot();
+        //with dup_filter: the prune edges scored exactly this round
+        dups.round(spr_input,spr_edge,spr_order);
+
+        //improving moves of the prune edges, with multi_moves: the best one of each edge
+        std::vector<aw::SPRLeafMove> moves;
+        //the best candidate of the round and its prune edge (index into spr_order); its
+        //tree is built once at the end of the round
+        aw::SPRCandidate best;
+        unsigned int best_qi = NONODE;
+
+        if((!parallel_edges && !rank_edges) || par::in_parallel()) {
+            //one worker that owns the input trees for this round
+            aw::SPRWorker worker;
+            worker.swap(g_trees,g_lca);
+            float bound = bestScore;
+            std::vector<unsigned int> root_at;
+            for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi) {
+                aw::SPRMove m;
+                if(!aw::spr_prepare(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,m)) continue;
+                const boost::dynamic_bitset<> prn = aw::pruned_gids(m);
+                aw::spr_roots(spr_input,m,worker.g_trees,root_at);
+                if(dups.skip(qi,prn)) { worker.root_inputs(root_at); continue; }
+                std::vector<aw::SPRCandidate> found;
+                float edge_bound = scr;     //every prune edge keeps its own best move
+                worker.evaluate(spr_input,m,root_at,multi_moves ? edge_bound : bound,found);
+                BOOST_FOREACH(aw::SPRCandidate &c, found)
+                    if((bestScore-c.score) > EPSILON) {
+                        best = c; best_qi = qi; bestScore = c.score; }
+                if(multi_moves && !found.empty() && (scr-found.back().score) > EPSILON) {
+                    std::vector<char> prune;
+                    aw::prune_leaves(spr_input,m,prune);
+                    aw::Tree t;
+                    aw::candidate_tree(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,found.back(),t);
+                    aw::SPRLeafMove mv;
+                    if(aw::describe_move(t,found.back().score,prune,mv)) moves.push_back(mv); }
+            }
+            worker.swap(g_trees,g_lca);
+        } else {
+            //every worker starts from the input trees as they are at the start of the round
+            std::vector<aw::SPRWorker> workers(par::threads());
+            BOOST_FOREACH(aw::SPRWorker &w, workers) {
+                w.g_trees = g_trees; w.g_lca = g_lca; }
+
+            //replay the rootings of the input trees a serial search would do, as the
+            //rooting left by one prune edge decides how the next one is rooted
+            std::vector<std::vector<unsigned int> > roots(spr_order.size());
+            std::vector<boost::dynamic_bitset<> > prns(spr_order.size());
+            std::vector<char> rerooted(g_trees.size(),0);
+            for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi) {
+                aw::SPRMove m;
+                if(!aw::spr_prepare(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,m)) continue;
+                prns[qi] = aw::pruned_gids(m);
+                aw::spr_roots(spr_input,m,g_trees,roots[qi]);
+                for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k)
+                    if(roots[qi][k]!=NONODE && !g_trees[k].is_adjacent(0,roots[qi][k])) {
+                        aw::reroot_gene(g_trees[k],roots[qi][k]);
+                        rerooted[k] = 1; }
+                if(dups.skip(qi,prns[qi])) roots[qi].clear();     //nothing to evaluate
+            }
 
-                //Storing leaves below x in s_tree with tag 'x' and others with 'y'
-                //y is parent of x or both are siblings (for edge having root (0)) in s_tree
-                boost::unordered_map<unsigned int, char> slid2char;
-                unsigned int reg_leaf = NONODE;
+            //a supertree can only become the best one if it scores below every supertree met
+            //before it, so edge_min (best score of the finished prune edges) prunes what is kept
+            std::vector<std::vector<aw::SPRCandidate> > found(spr_order.size());
+            std::vector<float> edge_min(spr_order.size(),bestScore);
+            std::vector<char> done(spr_order.size(),0);
+            const float round_best = bestScore;
+            #pragma omp parallel for schedule(dynamic,1)
+            for (int qi=0; qi<(int)spr_order.size(); ++qi) {
+                if(roots[qi].empty()) continue;
+                if(rank_edges && qi%par::size()!=par::rank()) continue;
+                aw::SPRWorker &worker = workers[par::thread_id()];
+                aw::SPRMove m;
+                aw::spr_prepare(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,m);
+                float bound = bestScore;
+                #pragma omp critical(spr_found)
+                for (int e=0; e<qi && !multi_moves; ++e)
+                    if(done[e] && edge_min[e]<bound) bound = edge_min[e];
+                std::vector<aw::SPRCandidate> f;
+                worker.evaluate(spr_input,m,roots[qi],bound,f);
+                #pragma omp critical(spr_found)
                 {
-                    TREE_FOREACHLEAF(vl,s_tree)  slid2char[vl]='y';
-                    for (aw::Tree::iterator_dfs v1=s_tree.begin_dfs(x,px),vEE1=s_tree.end_dfs(); v1!=vEE1; ++v1) {
-                        if(v1.idx == px) break;
-                        if(s_tree.is_leaf(v1.idx)) slid2char[v1.idx]='x';   }
-                }
-
-                //for generalization
-                unsigned int prn_side, rgft_side;
-                char my_char, oth_char;
-                if(reg_x) {
-                    prn_side=x; rgft_side=y; my_char = 'x'; oth_char = 'y';
-                } else {
-                    prn_side=y; rgft_side=x; my_char = 'y'; oth_char = 'x';}
-
-                if(constr) {  //FOR CONSTRAINT ----------------------------------------------------------------
-                    if(px!=y) {
-                        if(s_tree.constr_num(x)!= NONODE && s_tree.constr_num(y)!=NONODE) { continue;
-                        } else if(s_tree.constr_num(x)!=NONODE) {
-                            if(prn_side==y) continue;
-                        } else if(s_tree.constr_num(y)!=NONODE) {
-                            if(prn_side==x) continue;
-                        }
-                    }
-                    else {
-                        if(s_tree.constr_num(x) != NONODE) {  //x side can be pruned but no y side since x makes a clade
-                            if(s_tree.constr_num(y) != NONODE)  ERROR_exit("ERROR");
-                            if(prn_side==y)  continue;
-                        } else if(s_tree.constr_num(y) != NONODE) {  //y side can be pruned but no x side since y makes a clade
-                            if(s_tree.constr_num(x) != NONODE)  ERROR_exit("ERROR");
-                            if(prn_side==x)  continue;
-                        } else if(s_tree.in_cld(x)==s_tree.in_cld(y) && s_tree.constr_num(x)==NONODE && s_tree.constr_num(y)==NONODE) {
-                            //LIMITED regraft
-                            if(prn_side==y) continue;
-                        }
+                    edge_min[qi] = bound; done[qi] = 1;
+                    found[qi].swap(f);
+                    for (unsigned int e=qi+1,eEE=spr_order.size(); e<eEE && !multi_moves; ++e) {
+                        if(found[e].empty()) continue;
+                        std::vector<aw::SPRCandidate> keep;
+                        BOOST_FOREACH(aw::SPRCandidate &c, found[e])
+                            if(c.score < bound) keep.push_back(c);
+                        found[e].swap(keep);
                     }
                 }
+            }
 
-                TREE_FOREACHLEAF(v2,s_tree) { // find a leaf that is not multiple
-                    bool flgg = false;
-                    if(slid2char[v2]== oth_char) {
-                        std::vector<unsigned int> ch;
-                        s_tree.adjacent(v2,ch);
-                        if(ch.size()>1) ERROR_exit("Leaf has more than one adjacent nodes!");
-                        if(!s_tree.is_fake(ch[0])) {
-                            reg_leaf=v2;
-                            flgg = true; }
-                        else {
-                            reg_leaf = ch[0];
-                            flgg = true; }
-                    }
-                    if(flgg) {
-                        if(constr) {  //FOR CONSTRAINT ----------------------------------------------------------------
-                            if(s_tree.constr_num(prn_side)!=NONODE) {   //can go any where but in an another clade
-                                if(s_tree.in_cld(reg_leaf)!=NONODE)
-                                    continue;
-                            } else {
-                                if(s_tree.in_cld(prn_side)!=s_tree.in_cld(reg_leaf))
-                                    continue;
-                            }
-                        }
-                        break;
-                    }
+            //scores of the kept supertrees of all processes, each tagged by prune edge and position
+            std::string buf;
+            for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi)
+                BOOST_FOREACH(aw::SPRCandidate &c, found[qi]) {
+                    par::pack(buf,qi); par::pack(buf,c.pos); par::pack(buf,c.score); }
+            std::vector<std::string> bufs;
+            par::gather(buf,bufs,true);
+            std::vector<std::vector<std::pair<unsigned int,float> > > kept(spr_order.size());
+            BOOST_FOREACH(std::string &b, bufs)
+                for (std::size_t at=0; at<b.size(); ) {
+                    unsigned int qi, pos; float score;
+                    par::unpack(b,at,qi); par::unpack(b,at,pos); par::unpack(b,at,score);
+                    kept[qi].push_back(std::make_pair(pos,score)); }
+
+            //same choice as the serial search: lowest score, ties go to the earlier prune edge
+            unsigned int win_qi = NONODE, win_pos = 0;
+            for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi) {
+                std::sort(kept[qi].begin(),kept[qi].end());
+                for (unsigned int i=0,iEE=kept[qi].size(); i<iEE; ++i)
+                    if((bestScore-kept[qi][i].second) > EPSILON) {
+                        win_qi = qi; win_pos = kept[qi][i].first; bestScore = kept[qi][i].second; }
+            }
+            if(win_qi!=NONODE) {
+                //the winner of another process is evaluated again here
+                if(found[win_qi].empty()) {
+                    aw::SPRMove m;
+                    aw::spr_prepare(spr_input,spr_edge[spr_order[win_qi].first],spr_order[win_qi].second,m);
+                    float bound = round_best;
+                    workers[0].evaluate(spr_input,m,roots[win_qi],bound,found[win_qi]);
                 }
-                
-                if(reg_leaf==NONODE) ERROR_exit("Uninitialised reg_leaf");
-                int round = us_tree.spr_to_edge(prn_side,rgft_side,reg_leaf);   //Regraaft XX above reg_leaf in YY
-
-                if(round == 0) {
-                    treeEft.clear();  rs_trees.clear();
-                    std::vector<char> reroot (g_trees.size());
-                    for (unsigned int k=0,kEEE=g_trees.size(); k<kEEE; ++k) {
-                        bool noX = false, noY = false;
-                        unsigned int rootAt, old_root;
-                        TREE_FOREACHLEAF(w,g_trees[k]) {
-                            unsigned int gid = g_nmaps[k].gid(w);
-                            unsigned int sid = s_nmap.one_id(gid);
-                            if(!noX && slid2char[sid]==my_char) noX = true;
-                            if(!noY && slid2char[sid]==oth_char) { rootAt = w; noY = true;}
-                            if(noX && noY) break;   //ADDED 9th SEPT
-                        }
-                        rs_trees.push_back(us_tree);
-
-                        if(!noX || !noY) {
-                            treeEft.push_back(false);  continue;   } //NO Need to do for this round of this tree
-                        else treeEft.push_back(true);
-
-                        BOOST_FOREACH(const unsigned int &w, g_trees[k].adjacent(0))
-                            if(g_trees[k].is_leaf(w)) old_root = w;  //Assuming input trees have more than 2 leaf3
-
-                        //check if we really need to reroot input tree
-                        unsigned int gid = g_nmaps[k].gid(old_root);
-                        unsigned int sid = s_nmap.one_id(gid);
-                        if(slid2char[sid]==oth_char){
-                            rootAt = old_root;
-                            reroot[k] = 'N';   }
-                        else  reroot[k] = 'Y';
-
-                         //rooting s_tree & g_tree by same leaf
-                        if(reroot[k]=='Y') g_trees[k].rootBy(rootAt);
-                        unsigned int gRootAt = g_nmaps[k].gid(rootAt);                        
-                        std::vector<unsigned int> child;
-                        s_nmap.ids(gRootAt,child);
-                        std::vector<unsigned int> ch1;
-                        rs_trees.back().adjacent(child[0],ch1);
-                        if(ch1.size()>1) ERROR_exit("Leaf has more than one adjacent nodes!");
-                        BOOST_FOREACH(const unsigned int &c,child){    //:FOR MUL-TREES
-                            if(s_lmaps[k].mapping(c)==rootAt) 
-                                rs_trees.back().addRoot(c,ch1[0]);                            
-                        }                        
-                    }
-
-                    {   //Computing cluster size for supertrees: computed based on leaf mapping
-                        unsigned int count;
-                        for (unsigned int k=0, kEE=rs_trees.size(); k<kEE; ++k){
-                            if(!treeEft[k]) continue;
-                            TREE_POSTORDER2(v,rs_trees[k]) {                                
-                                if (!rs_trees[k].is_leaf(v.idx)) {                                      
-                                    count = 0;
-                                    BOOST_FOREACH(const unsigned int &c,rs_trees[k].children(v.idx,v.parent))
-                                        count = count + rs_trees[k].return_clstSz(c);
-                                    rs_trees[k].update_clst(v.idx,count);  }
-                                else {
-                                    if(s_lmaps[k].mapping(v.idx)!=NONODE)    //:FOR MUL-TREES
-                                        rs_trees[k].update_clst(v.idx,1);
-                                    else rs_trees[k].update_clst(v.idx,0);  }
-                            }
-                        }
-                    }
-                    
-                    {   //Calculate cluster size for input trees
-                        unsigned int count;
-                        for (unsigned int k=0, kEE=g_trees.size(); k<kEE; ++k){
-                            if(!treeEft[k] || (reroot[k]=='N')) continue;                            
-                            TREE_POSTORDER2(v, g_trees[k])
-                                if (g_trees[k].is_leaf(v.idx))
-                                    g_trees[k].update_clst(v.idx,1);
-                                else {  count = 0;
-                                    BOOST_FOREACH(const unsigned int &c,g_trees[k].children(v.idx,v.parent))
-                                        count += g_trees[k].return_clstSz(c);
-                                    g_trees[k].update_clst(v.idx,count); }
-                        }
-                    }
-                    
-                    std::vector<unsigned int> g_score;
-                    float score = 0;
-                    {
-                        aw::LCA lca;
-                        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-                            if(!treeEft[i] || (reroot[i]=='N')) continue;
-                            lca.create(g_trees[i]);
-                            g_lca.erase(g_lca.begin()+i);
-                            g_lca.insert(g_lca.begin()+i,lca);
-                        }
-                        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-                            if(!treeEft[i]) continue;
-                            s_lmaps[i].update_LCA_internals(g_lca[i],rs_trees[i]); }
-                        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-                            if(!treeEft[i]){ g_score.push_back(g_scr[i]);
-                                score = score + g_scr[i]; continue; }
-                            std::pair<unsigned int,unsigned int> p = g_nodes[i];
-                            g_score.push_back(aw::compute_rf_score(rs_trees[i],g_trees[i],s_lmaps[i],p,rs_int_nodes[i]));
-                            score = score + g_score[i]*g_weights[i] ;
-                        }
-                    }
-
-                    //for easy parent-child relationship in rs_trees
-                    std::vector<aw::SubtreeParent<aw::Tree> > rs_parents(rs_trees.size());
-                    for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k) {
-                        if(!treeEft[k]) continue;
-                        rs_parents[k].create(rs_trees[k]);
-                    }
-
-                    //rooting us_tree for iteration
-                    unsigned int reg_leaf_adj;
-                    BOOST_FOREACH(const unsigned int &w, us_tree.adjacent(rgft_side))
-                        if(w!=reg_leaf && w!=prn_side) reg_leaf_adj = w;
-
-                    us_tree.addRoot(reg_leaf,rgft_side);  //root it for traversal
-                    if((bestScore-score) > EPSILON) {
-                    bestTree = us_tree; bestScore = score; }
-                    aw::SubtreeParent<aw::Tree> us_parent; us_parent.create(us_tree);
-
-                    unsigned int last_a, last_b, last_c, a1, b1, c1;
-                    std::string last_dir;
-                    bool fake = false;
-
-                    if(us_tree.is_fake(reg_leaf_adj) || us_tree.is_leaf(reg_leaf_adj)) continue;
-
-                    //*************************     Starting MOVE-DOWN thing     **************************************************************************************
-                    for (aw::Tree::iterator_dfs p=us_tree.begin_dfs(reg_leaf_adj,rgft_side),pEE=us_tree.end_dfs(); p!=pEE; ++p) {                        
-                        if(p.idx == reg_leaf_adj) continue;
-                        
-                        if(fake && !us_tree.is_fake(p.idx)) continue;
-
-                        if(constr) {  //FOR CONSTRAINT..............
-                            if(us_tree.constr_num(prn_side)!=NONODE) { //x is root of a clade
-                                if(us_tree.in_cld(p.idx)!=NONODE && us_tree.constr_num(p.idx)==NONODE)
-                                    continue;
-                            } else if(us_tree.constr_num(prn_side)==NONODE && us_tree.in_cld(prn_side)!=NONODE) { //x inside a clade
-                                if(us_tree.in_cld(prn_side)!=us_tree.in_cld(p.idx))
-                                    continue;
-                            } else {  //x is no where clade
-                                if(us_tree.in_cld(p.idx)!=NONODE && us_tree.constr_num(p.idx)==NONODE)
-                                    continue;
-                            }
-                        }
+                BOOST_FOREACH(aw::SPRCandidate &c, found[win_qi])
+                    if(c.pos==win_pos) { best = c; best_qi = win_qi; }
+            }
 
-                        //Moving subtree X from {a1,b1} to edge {b1,c1}
-                        switch (p.direction) {
-                            case aw::PREORDER: {                                
-                                if(p.parent != reg_leaf_adj) {
-                                    if(last_dir=="PRE") {
-                                        a1 = last_b; b1 = last_c; c1 = p.idx;
-                                    } else {
-                                        a1 = last_c; b1 = last_b; c1 = p.idx;
-                                    }
-                                } else { //in the start of traversal
-                                    a1 = reg_leaf; b1 = reg_leaf_adj; c1 = p.idx;
-                                }
-                                last_dir = "PRE";
-                                if(us_tree.is_fake(p.idx))
-                                    fake = !fake;                                
-                            } break;
-
-                            case aw::POSTORDER: {                                
-                                if(last_dir=="PRE") {
-                                    a1 = last_c; b1 = last_b; c1 = last_a;
-                                } else {
-                                    a1 = last_b; b1 = last_c; c1 = us_parent.parent(last_c);
-                                    if(c1 == rgft_side) c1 = reg_leaf;
-                                }
-                                last_dir = "POST";
-                                if(us_tree.is_fake(p.idx)) fake = !fake;
-                            } break;
-                            default: {continue;} break;
-                        }
-                        
-                        last_a = a1; last_b = b1; last_c = c1;
-                        if(us_tree.is_fake(b1) && us_tree.is_leaf(c1))
-                            ERROR_exit("Wrong move-down");
-
-                        //find the score of each tree when regrafted x-subtree at edge {b1,c1} from {a1,b1}
-                        for (unsigned int i=0,iEE=rs_trees.size(); i<iEE; ++i) {
-                            if(!treeEft[i]) continue;
-                            if(rs_parents[i].parent(c1)==b1 && rs_parents[i].parent(b1)==rgft_side) {
-                                unsigned int real_a1;
-                                if(rs_parents[i].parent(rgft_side)==a1) real_a1 = a1;
-                                else if(rs_parents[i].parent(rgft_side)==0) real_a1=0;
-                                else ERROR_exit("Error in the tree");
-
-                                unsigned int sib_c1 = rs_parents[i].sibling_binary(c1);
-                                rs_trees[i].moveSub(real_a1,b1,c1,rgft_side);  //update tree
-                                rs_parents[i].tPtrUpdate(rs_trees[i]); //update parent-child relationships
-                                rs_parents[i].update(c1,rgft_side);
-                                rs_parents[i].update(rgft_side,b1);
-                                rs_parents[i].update(b1,real_a1);
-
-                                //update lca and score
-                                unsigned int old_b1_map = s_lmaps[i].mapping(b1);
-                                unsigned int old_yy_map = s_lmaps[i].mapping(rgft_side);
-                                unsigned int new_yy_map = g_lca[i].lca(s_lmaps[i].mapping(prn_side),s_lmaps[i].mapping(c1));
-                                unsigned int old_b1_map_scr = g_trees[i].return_score(old_b1_map);
-                                g_score[i] = g_score[i] + rc::old_map_chg(rs_trees[i],g_trees[i],b1,c1,sib_c1,old_b1_map,old_b1_map_scr);
-                                g_trees[i].update_score(old_b1_map,old_b1_map_scr);
-                                s_lmaps[i].set_LCA(b1,old_yy_map);
-                                s_lmaps[i].set_LCA(rgft_side,new_yy_map);
-                                unsigned int new_yy_map_scr = g_trees[i].return_score(new_yy_map);
-                                g_score[i] = g_score[i] + rc::new_map_chg(rs_trees[i],g_trees[i],rgft_side,prn_side,c1,new_yy_map,new_yy_map_scr);
-                                g_trees[i].update_score(new_yy_map,new_yy_map_scr);
-
-                                //update clusters
-                                rs_trees[i].update_clst(b1,rs_trees[i].return_clstSz(rgft_side));
-                                rs_trees[i].update_clst(rgft_side,rs_trees[i].return_clstSz(prn_side)+rs_trees[i].return_clstSz(c1));
-                            } else if(rs_parents[i].parent(rgft_side)==b1 && rs_parents[i].parent(c1)==b1) {
-                                rs_trees[i].moveSub(a1,b1,c1,rgft_side);  //update tree
-                                rs_parents[i].tPtrUpdate(rs_trees[i]); //update parent-child relationships
-                                rs_parents[i].update(c1,rgft_side);
-                                rs_parents[i].update(rgft_side,b1);
-                                rs_parents[i].update(a1,b1);
-
-                                //update lca and score
-                                unsigned int old_yy_map = s_lmaps[i].mapping(rgft_side);
-                                unsigned int new_yy_map = g_lca[i].lca(s_lmaps[i].mapping(prn_side),s_lmaps[i].mapping(c1));
-                                unsigned int old_yy_map_scr = g_trees[i].return_score(old_yy_map);
-                                g_score[i] = g_score[i] + rc::old_map_chg(rs_trees[i],g_trees[i],rgft_side,prn_side,a1,old_yy_map,old_yy_map_scr);
-                                g_trees[i].update_score(old_yy_map,old_yy_map_scr);
-                                s_lmaps[i].set_LCA(rgft_side,new_yy_map);
-                                unsigned int new_yy_map_scr = g_trees[i].return_score(new_yy_map);
-                                g_score[i] = g_score[i] + rc::new_map_chg(rs_trees[i],g_trees[i],rgft_side,prn_side,c1,new_yy_map,new_yy_map_scr);
-                                g_trees[i].update_score(new_yy_map,new_yy_map_scr);
-
-                                //update clusters
-                                rs_trees[i].update_clst(rgft_side,rs_trees[i].return_clstSz(prn_side)+rs_trees[i].return_clstSz(c1));
-                            }  else if(rs_parents[i].parent(a1)==rgft_side && rs_parents[i].parent(rgft_side)==b1) {
-                                unsigned int real_c1;
-                                if(rs_parents[i].parent(b1)==c1) real_c1 = c1;
-                                else if(rs_parents[i].parent(b1)==0) real_c1=0;
-                                else ERROR_exit("Error in the tree");
-
-                                unsigned int sib_yy = rs_parents[i].sibling_binary(rgft_side);
-                                rs_trees[i].moveSub(a1,b1,real_c1,rgft_side);  //update tree
-                                rs_parents[i].tPtrUpdate(rs_trees[i]); //update parent-child relationships
-                                rs_parents[i].update(b1,rgft_side);
-                                rs_parents[i].update(rgft_side,real_c1);
-                                rs_parents[i].update(a1,b1);
-
-                                //update lca and score
-                                unsigned int old_yy_map = s_lmaps[i].mapping(rgft_side);
-                                unsigned int old_b1_map = s_lmaps[i].mapping(b1);
-                                unsigned int new_b1_map = g_lca[i].lca(s_lmaps[i].mapping(sib_yy),s_lmaps[i].mapping(a1));
-                                unsigned int old_yy_map_scr = g_trees[i].return_score(old_yy_map);
-                                g_score[i] = g_score[i] + rc::old_map_chg(rs_trees[i],g_trees[i],rgft_side,prn_side,a1,old_yy_map,old_yy_map_scr);
-                                g_trees[i].update_score(old_yy_map,old_yy_map_scr);
-                                s_lmaps[i].set_LCA(rgft_side,old_b1_map);
-                                s_lmaps[i].set_LCA(b1,new_b1_map);
-                                unsigned int new_b1_map_scr = g_trees[i].return_score(new_b1_map);
-                                g_score[i] = g_score[i] + rc::new_map_chg(rs_trees[i],g_trees[i],b1,sib_yy,a1,new_b1_map,new_b1_map_scr);
-                                g_trees[i].update_score(new_b1_map,new_b1_map_scr);
-
-                                //update clusters
-                                rs_trees[i].update_clst(rgft_side,rs_trees[i].return_clstSz(b1));
-                                rs_trees[i].update_clst(b1,rs_trees[i].return_clstSz(sib_yy)+rs_trees[i].return_clstSz(a1));
-                            }
-                            else  ERROR_exit("SOME ERROR");
-                        }
+            for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k)
+                if(rerooted[k]) g_lca[k].update_root(g_trees[k]);
+
+            if(multi_moves)
+                for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi) {
+                    if(found[qi].empty() || (scr-found[qi].back().score) <= EPSILON) continue;
+                    aw::SPRMove m;
+                    aw::spr_prepare(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,m);
+                    std::vector<char> prune;
+                    aw::prune_leaves(spr_input,m,prune);
+                    aw::Tree t;
+                    aw::candidate_tree(spr_input,spr_edge[spr_order[qi].first],spr_order[qi].second,found[qi].back(),t);
+                    aw::SPRLeafMove mv;
+                    if(aw::describe_move(t,found[qi].back().score,prune,mv)) moves.push_back(mv);
+                }
+        }
 
-                        score = 0;
-                        for (unsigned int mm=0,mmEE=g_trees.size(); mm<mmEE; ++mm)
-                            score = score + g_score[mm]*g_weights[mm] ;
-
-                        if((bestScore-score) > EPSILON) {
-                            for(int mn=0, mnEE=treeEft.size(); mn<mnEE; ++mn)
-                                if(treeEft[mn]) {
-                                    bestTree = rs_trees[mn];
-                                    break; }
-                            bestScore = score; }
-                    }                    
-                }                
+        if(best_qi!=NONODE)
+            aw::candidate_tree(spr_input,spr_edge[spr_order[best_qi].first],spr_order[best_qi].second,best,bestTree);
+
+        //apply the best moves of other prune edges together with the best one when they
+        //change disjoint parts of the supertree; kept only if the exact score is lower
+        if(moves.size()>1) {
+            std::stable_sort(moves.begin(),moves.end(),aw::move_before);
+            aw::Tree comb;
+            if(aw::combine_moves(s_tree,moves,comb)>1) {
+                const float comb_score = aw::supertree_score(spr_input,comb,g_trees,g_lca,s_induced);
+                if((bestScore-comb_score) > EPSILON) {
+                    bestTree = comb; bestScore = comb_score; ++multi_applied; }
             }
-            reg_x = !reg_x;
         }
 
-        MSG_nonewline('\r');
-        MSG_nonewline("Current RF Score: "<<std::fixed<<std::setprecision(2)<< bestScore);
+        if(verbose) {
+            MSG_nonewline('\r');
+            MSG_nonewline("Current RF Score: "<<std::fixed<<std::setprecision(2)<< bestScore); }
 
         s_tree = bestTree;       
 
@@ -1319,99 +942,422 @@ int main(int ac, char* av[]) {
             }
         }
 
+        //a filtered round without improvement is completed with the prune edges it left out
+        if(dups.again(bestScore!=scr) && bestScore!=0) continue;
         if(bestScore == 0 || bestScore==scr)  break;  //exit if no improvement or score is already zero
         
-        { // root the supertree copies again by one leaf
-            rs_trees.clear();  unsigned int rt;
-            for (unsigned int k=0, iEE=g_trees.size(); k<iEE; ++k) {               
-                BOOST_FOREACH(const unsigned int &w, g_trees[k].adjacent(0))
-                    if(g_trees[k].is_leaf(w)) rt = w;                
-                unsigned int ggid = g_nmaps[k].gid(rt);
-                std::vector<unsigned int> ch;
-                s_nmap.ids(ggid,ch);
-                unsigned int s_id;
-                BOOST_FOREACH(const unsigned int &c,ch)
-                    if(s_lmaps[k].mapping(c)==rt)
-                        s_id = c;                
-                rs_trees.push_back(s_tree);
-                rs_trees.back().rootBy(s_id);                
+        g_scr.clear(); scr = 0;
+        {   //no need to do LCA computations again...
+            s_induced.update(s_tree,s_nmap);
+            for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i)
+                g_scr.push_back(s_induced.rf_score(i,g_trees[i],g_nmaps[i],g_lca[i],g_nodes[i],rs_int_nodes[i]));
+            scr = aw::weighted_score(g_scr,g_weights);
+            if(fabs(scr-bestScore)>EPSILON) ERROR_exit("SCR and bestScore doesn't match!!!");
+        }        
+    }
+
+    if(verbose) MSG("\nSPR neighborhood searches: "<<SPR_rounds);
+    if(verbose && multi_moves) MSG("Rounds with combined SPR moves: "<<multi_applied);
+
+    {   //preprocessing of s_tree for output
+    BOOST_FOREACH(const gid2ctype::value_type &w, gid2cnt) {
+        unsigned int ggid = w.first;
+        int l_cnt = w.second;
+        if(l_cnt==1) continue;
+        unsigned int sid,adj;
+        sid = s_nmap.one_id(ggid); //since initial supertree is not multilabeled
+        std::vector<unsigned int> ch;
+        s_tree.adjacent(sid,ch);
+        unsigned int fakeInt = ch[0];
+        BOOST_FOREACH(const unsigned int &c, s_tree.adjacent(fakeInt)) 
+            if(!s_tree.is_leaf(c)) { adj = c;  break; }                    
+                         
+        s_tree.disconnect_node(fakeInt);
+        s_tree.add_edge(sid,adj);
+    }
+
+    //if constr then reroot
+    if(constr) {
+        if(s_tree.root==0) {
+            TREE_FOREACHLEAF(lf, s_tree) {  //Added on 29th May
+                if(s_tree.in_cld(lf)==NONODE)
+                    s_tree.rootBy(lf);
             }
         }
+    }
+    
+    }
 
-        {   //Computing cluster size for supertrees: computed based on leaf mapping
-            unsigned int count;
-            for (unsigned int k=0, kEE=rs_trees.size(); k<kEE; ++k){                
-                TREE_POSTORDER2(v,rs_trees[k]) {                   
-                    if (!rs_trees[k].is_leaf(v.idx)) {                         
-                        count = 0;
-                        BOOST_FOREACH(const unsigned int &c,rs_trees[k].children(v.idx,v.parent))
-                            count = count + rs_trees[k].return_clstSz(c);
-                        rs_trees[k].update_clst(v.idx,count);      }
-                    else {                                               
-                        if(s_lmaps[k].mapping(v.idx)!=NONODE)    //:FOR MUL-TREES
-                            rs_trees[k].update_clst(v.idx,1);
-                        else rs_trees[k].update_clst(v.idx,0);   }                    
-                }
+    res.score = bestScore;
+    res.g_scr = g_scr;
+    res.SPR_rounds = SPR_rounds;
+}
+
+/*
+ * Output of a search: initial tree (with --initialtree), supertree and, with
+ * --inputrees, the input trees rooted as they were scored last
+ */
+void write_result(std::ostream &output, SearchResult &res, SearchInput &in, std::vector<aw::idx2name> &g_taxa, const bool inputrees) {
+    output << res.initial_tree;
+    output <<"[ Species Tree: Unrooted RF Score = "<<std::fixed<<std::setprecision(2)<<res.score<<"]"<< std::endl;
+    aw::tree2newick(output,res.s_tree,res.s_taxa); output << std::endl;
+
+    if(inputrees) {
+        for(int mn=0, mnEE=res.g_trees.size(); mn<mnEE; ++mn) {
+             output <<"\n[ Gene Tree "<<mn<< " MulRF Score = "<<std::fixed<<std::setprecision(2)<<res.g_scr[mn]*in.g_weights[mn]<<"]"<< std::endl;
+             output<<"[&WEIGHT="<<std::fixed<<std::setprecision(2)<<in.g_weights[mn]<<"]";
+             aw::tree2newick(output,res.g_trees[mn],g_taxa[mn]); output << std::endl; } }
+}
+
+/*
+ * 
+ */
+int main(int ac, char* av[]) {
+    par::init(&ac,&av);
+    {
+        std::ostringstream os; os << "command:";
+        for (int i = 0; i < ac; i++) os << ' ' << av[i];
+        MSG(os.str());
+    }
+    std::string trees_filename;
+    std::string c_filename;
+    bool stree_first = false;
+    std::string output_filename;    
+    bool alltrees = false;
+    bool initialtree = false;
+    bool inputrees = false;
+    bool constr = false;    
+    unsigned int seed = std::time(0);
+    unsigned int threads = 1;
+    unsigned int replicates = 1;
+    bool parallel_edges = false;
+    bool multi_moves = false;
+    unsigned int dup_filter = 0;
+    {
+        Argument a; a.add(ac, av);
+        // help
+        if (a.existArg2("-h","--help")) {
+            MSG("options:");
+            MSG("  -i [ --input ] arg      input trees (file in NEWICK format)");
+            MSG("       --stree            first input tree is a starting species tree");
+            MSG("  -c [--constraints] arg   constraints");
+            MSG("  -o [ --output ] arg     write the trees into a file (file in NEWICK format)");
+            MSG("       --alltrees         synonym for --initialtree and --inputrees");
+            MSG("       --initialtree      output the initial species tree");
+            MSG("       --inputrees        output the input trees");            
+            MSG("       --seed arg         random generator seed");            
+            MSG("       --threads arg      number of worker threads for evaluating input trees");
+            MSG("       --parallel-edges   let the worker threads evaluate SPR prune edges instead");
+            MSG("       --replicates arg   number of searches, each with its own random stream of the seed");
+            MSG("       --multi-moves      apply non-conflicting improving SPR moves together");
+            MSG("       --dup-filter arg   score only this many prune edges of a round exactly, ranked by gene duplications");
+            MSG("  -h [ --help ]           produce help message");
+            MSG("");
+            MSG("example:");
+            MSG("  " << av[0] << " -i inputF.newick -o outputF.newick");
+            exit(0);
+        }
+        
+        // input trees
+        if (a.existArgVal2("-i", "--input", trees_filename)) MSG("input file: " << trees_filename) else MSG("using standard input");
+        // starting species tree
+        stree_first = a.existArg("--stree");
+        // constraints 
+        if (a.existArgVal2("-c","--constraints", c_filename)) {
+            MSG("constraints file: " << c_filename);
+            constr = true;
+        }        
+        if(constr && stree_first)  WARNING("Constraints doesn't work with starting species tree!");
+      
+        // output file
+        if (a.existArgVal2("-o", "--output", output_filename)) MSG("output file: " << output_filename);
+        // output initial species tree
+        initialtree = a.existArg("--initialtree");
+        // output gene trees
+        inputrees = a.existArg("--inputrees");        
+        // output all trees
+        alltrees = a.existArg("--alltrees");
+        if (alltrees) {
+            inputrees = true;
+            initialtree = true;
+        }
+        // random seed
+        a.existArgVal("--seed", seed);
+        par::bcast(seed);   //the processes of an MPI run all search with the seed of rank 0
+        MSG("seed: " << seed);
+        // worker threads
+        if (a.existArgVal("--threads", threads)) {
+            if (threads == 0) ERROR_exit("--threads needs a positive value");
+            if (!par::available() && threads > 1) {
+                WARNING("compiled without OpenMP support, using 1 thread");
+                threads = 1;
             }
+            MSG("threads: " << threads);
         }
+        par::set_threads(threads);
+        // independent searches
+        if (a.existArgVal("--replicates", replicates)) {
+            if (replicates == 0) ERROR_exit("--replicates needs a positive value");
+            MSG("replicates: " << replicates);
+        }
+        if (a.existArg("--parallel-edges")) {
+            parallel_edges = true;
+            MSG("parallel prune edges: on");
+        }
+        if (a.existArg("--multi-moves")) {
+            if (constr) {
+                WARNING("--multi-moves is not used with constraints");
+            } else {
+                multi_moves = true;
+                MSG("multiple SPR moves per round: on");
+            }
+        }
+        if (a.existArgVal("--dup-filter", dup_filter)) {
+            if (dup_filter == 0) ERROR_exit("--dup-filter needs a positive value");
+            MSG("duplication prefilter: " << dup_filter << " prune edges per round");
+        }
+        // unknown arguments?
+        a.unusedArgsError();
+    }
+    // -----------------------------------------------------------------------------------
 
-        g_scr.clear(); scr = 0;
-        {   //no need to do LCA computations again...
-            for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-                s_lmaps[i].update_LCA_internals(g_lca[i],rs_trees[i]); }
-            for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
-                std::pair<unsigned int,unsigned int> p = g_nodes[i];
-                g_scr.push_back(aw::compute_rf_score(rs_trees[i],g_trees[i],s_lmaps[i],p,rs_int_nodes[i]));
-                scr = scr + g_scr[i]*g_weights[i] ;
-            }            
-            if(fabs(scr-bestScore)>EPSILON) ERROR_exit("SCR and bestScore doesn't match!!!");
-        }        
+    const double t3 = par::wtime();
+
+    //create output stream
+    std::ofstream ouput_fs;
+    if (!output_filename.empty() && par::rank()==0) {
+        ouput_fs.open(output_filename.c_str());
+        if (!ouput_fs) ERROR_exit("cannot write file '" << output_filename << "'");
     }
+    std::ostream &output = output_filename.empty() ? std::cout : ouput_fs;
 
-    MSG("\nSPR neighborhood searches: "<<SPR_rounds);
+    // read trees
+    // output:
+    SearchInput in;
+    in.stree_first = stree_first; in.constr = constr; in.initialtree = initialtree;
+    aw::Tree &s_tree = in.s_tree;
+    aw::idx2name &s_taxa = in.s_taxa;
+    std::vector<aw::Tree> &g_trees = in.g_trees;
+    std::vector<std::vector<std::string> > &c_taxa = in.c_taxa;
+    std::vector<aw::idx2name> g_taxa;    
+    aw::TreetaxaMap &s_nmap = in.s_nmap;
+    std::vector<float> &g_weights = in.g_weights;
+    {
+        // read trees -------------------------------------
+        {
+            const std::string filename = trees_filename;
+            std::ifstream ifs;
+            if (!filename.empty() && par::rank()==0) {
+                ifs.open(filename.c_str());
+                if (!ifs) ERROR_exit("cannot read file '" << filename << "'");
+            }
+            std::istringstream iss;
+            std::istream &is = par::shared(filename.empty() ? std::cin : ifs, iss);
+            if (stree_first) {
+                float t_w = 1.0f;  //we will not use this weight
+                if (!aw::stream2tree(is, s_tree, s_taxa,t_w)) ERROR_exit("No species tree found in file '" << filename << "'");
+            }
+            MSG_nonewline("Reading input trees: ");
+            aw::gauge_exp g; aw::gauge_init(&g);
+            for (;;) {
+                aw::Tree t;
+                aw::idx2name t_names;
+                float t_w = 1.0f;
+                if (!aw::stream2tree(is, t, t_names,t_w)) break;
+                g_taxa.push_back(t_names);
+                g_trees.push_back(t);
+                g_weights.push_back(t_w);
+                aw::gauge_inc(&g);
+            }
+            aw::gauge_end(&g);
+            MSG("Input trees: " << g_trees.size());
+            if (g_trees.empty()) ERROR_exit("No input trees found in file '" << filename << "'");
+         }
 
-    {   //outputing input trees and output super tree
-        {   //preprocessing of s_tree
-            BOOST_FOREACH(const gid2ctype::value_type &w, gid2cnt) {
-                unsigned int ggid = w.first;
-                int l_cnt = w.second;
-                if(l_cnt==1) continue;
-                unsigned int sid,adj;
-                sid = s_nmap.one_id(ggid); //since initial supertree is not multilabeled
-                std::vector<unsigned int> ch;
-                s_tree.adjacent(sid,ch);
-                unsigned int fakeInt = ch[0];
-                BOOST_FOREACH(const unsigned int &c, s_tree.adjacent(fakeInt)) 
-                    if(!s_tree.is_leaf(c)) { adj = c;  break; }                    
-                                 
-                s_tree.disconnect_node(fakeInt);
-                s_tree.add_edge(sid,adj);
+        // reading constriants file ----------------------------
+         if (constr) {   
+            std::ifstream ifs;
+            if (!c_filename.empty() && par::rank()==0) {
+                ifs.open(c_filename.c_str());
+                if (!ifs) ERROR_exit("cannot read file '" << c_filename << "'");
+            }
+            std::istringstream iss;
+            std::istream &is = par::shared(c_filename.empty() ? std::cin : ifs, iss);                        
+            for (;;) {
+                std::vector<std::string> constr_list;
+                if (!aw::stream2constr(is, constr_list)) break;
+                if(constr_list.size()<=1)
+                    ERROR_exit("Too small constraint!");
+                c_taxa.push_back(constr_list);
             }
 
-            //if constr then reroot
-            if(constr) {
-                if(s_tree.root==0) {
-                    TREE_FOREACHLEAF(lf, s_tree) {  //Added on 29th May
-                        if(s_tree.in_cld(lf)==NONODE)
-                            s_tree.rootBy(lf);
-                    }
+            MSG("Constraints: " << c_taxa.size());
+            if (c_taxa.empty()) ERROR_exit("No constraints found in file '" << c_filename << "'");
+        }       
+    }
+
+    if (stree_first) { // check input for binary        
+            TREE_FOREACHNODE(v,s_tree) {
+                const unsigned int d = s_tree.degree(v);
+                bool isroot = false;
+                if(s_tree.is_rooted()) isroot = (s_tree.root == v);
+                else isroot = (0 == v);
+                if (d == 0) continue; // single isolated node
+                if ((d == 1) && (!isroot)) continue; // leaf
+                if ((d == 3) && (!isroot)) continue; // binary interior node but not root
+                if ((d == 2) && isroot) continue; // root node with children
+                ERROR_exit("Initial species tree"<<" is not binary");
+            }
+        MSG("Initial species tree pass binary test");
+    }
+
+    // map taxa labels
+    aw::TaxaMap &taxamap = in.taxamap;  //to store all taxon and global id
+    std::vector<aw::TreetaxaMap> &g_nmaps = in.g_nmaps; //for mapping taxamap and idx2name (of a tree)    
+    {
+        g_nmaps.resize(g_taxa.size());
+        for (unsigned int i=0,iEE=g_taxa.size(); i<iEE; ++i) {
+            aw::idx2name &n = g_taxa[i];
+            taxamap.insert(n);
+            g_nmaps[i].create(n,taxamap);
+        }
+        MSG("Taxa: " << taxamap.size());
+    }
+  
+    // checking constraints
+    boost::unordered_map<unsigned int, unsigned int> &gid2c = in.gid2c; //<global id, order of its list>
+    {       
+        for (unsigned int i=0,iEE=c_taxa.size(); i<iEE; ++i) {
+            std::vector<std::string> ls = c_taxa[i];
+            BOOST_FOREACH(const std::string &st,ls) {
+                if(!taxamap.exist(st))
+                    ERROR_exit("Constraints error, unique taxa: "<<st);
+                unsigned int gid = taxamap.gid(st);
+
+                if(gid2c.find(gid) == gid2c.end())
+                    gid2c.insert(std::pair<unsigned int,unsigned int>(gid,i));
+                else
+                    ERROR_exit("Constraints error, overlap!");                
+            }                         
+        }        
+    }
+   
+    std::vector<std::pair<unsigned int,unsigned int> > &g_nodes = in.g_nodes;  //pair <internal node,leaf count>
+    std::vector<unsigned int> &root_leaf = in.root_leaf;    
+    { // gene tree nodes
+        unsigned int c = 0, t = 0, t1 = 0, c1 = 0;
+        for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k){
+            bool first = true;
+            TREE_PREORDER2(v,g_trees[k]) {
+                ++c;                
+                if (g_trees[k].is_leaf(v.idx)) {
+                    ++t;                  
+                    if(first) { root_leaf.push_back(g_nmaps[k].gid(v.idx)); first = false; }  
                 }
             }
-            
-            output <<"[ Species Tree: Unrooted RF Score = "<<std::fixed<<std::setprecision(2)<<bestScore<<"]"<< std::endl;
-            aw::tree2newick(output,s_tree,s_taxa); output << std::endl;
+            if(g_trees[k].degree(0)>2) ++c;
+            t1 +=t; c1 +=c;
+            g_nodes.push_back(std::pair<unsigned int,unsigned int>(c-t-1,t));            
+            t = 0; c = 0;
         }
-        
-        if(inputrees) {            
-            for(int mn=0, mnEE=g_trees.size(); mn<mnEE; ++mn) {
-                 output <<"\n[ Gene Tree "<<mn<< " MulRF Score = "<<std::fixed<<std::setprecision(2)<<g_scr[mn]*g_weights[mn]<<"]"<< std::endl;
-                 output<<"[&WEIGHT="<<std::fixed<<std::setprecision(2)<<g_weights[mn]<<"]";
-                 aw::tree2newick(output,g_trees[mn],g_taxa[mn]); output << std::endl; } }
+        MSG("Input tree nodes: " << c1 << " (" << t1 << " taxa)");
+    }
+
+    if (stree_first) {
+        aw::idx2name &n = s_taxa;
+        if(n.size()<taxamap.size())  ERROR_exit("Error: Initial species tree doesn't have all leaves!!");
+        taxamap.insert(n);
+        s_nmap.create(n,taxamap);        
+    }
+
+    //counting maximum number of copies of a gene node in a genetree
+    gid2ctype &gid2cnt = in.gid2cnt;    //<gid,count>    
+    {
+        for(unsigned int i=0,iKK=taxamap.size(); i<iKK; ++i) gid2cnt[i]=0;
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+            TREE_FOREACHLEAF(v,g_trees[i]) {
+                unsigned int gid_v = g_nmaps[i].gid(v);
+                int gid_cnt = g_nmaps[i].ids_count(gid_v);
+                if(gid2cnt[gid_v] < gid_cnt) gid2cnt[gid_v] = gid_cnt;
+        }   }
+        for(unsigned int i=0,iKK=taxamap.size(); i<iKK; ++i)
+          if(gid2cnt[i]==0) ERROR_exit("Error: Some leaf of the supertree is not in any of the input trees!!");
+    }
+
+    {   //LCAs of the input trees are built once and shared read only by all searches;
+        //a search rooting an input tree by another leaf only moves its RootedLCA
+        aw::LCA lca;
+        for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k) {
+            if (!in.stree_first) {
+                in.g_lca.push_back(lca);
+                in.g_lca.back().create(g_trees[k]); }
+            aw::Tree t = g_trees[k];
+            t.rootBy(g_nmaps[k].one_id(root_leaf[k]));
+            in.g_leaf_lca.push_back(lca);
+            in.g_leaf_lca.back().create(t);
+        }
+    }
+
+    //search: replicates run side by side, each with its own random generator; with MPI the
+    //replicates are dealt out to the processes, or they share the prune edges of one search
+    const bool rank_edges = replicates==1 && par::size()>1;
+    if (rank_edges && multi_moves) {
+        WARNING("--multi-moves is not used when MPI processes share one search");
+        multi_moves = false;
+    }
+    std::vector<int> mine;
+    for (int r=0; r<(int)replicates; ++r)
+        if(rank_edges || r%par::size()==par::rank()) mine.push_back(r);
+    std::vector<SearchResult> results(mine.size());
+    #pragma omp parallel for schedule(dynamic,1) if(mine.size()>1 && threads>1)
+    for (int j=0; j<(int)mine.size(); ++j) {
+        const int r = mine[j];
+        boost::mt19937 rng(par::stream_seed(seed,r));
+        search_supertree(in,rng,parallel_edges,rank_edges,multi_moves,dup_filter,replicates==1,results[j]);
+        if (replicates>1) {
+            #pragma omp critical(replicate_msg)
+            MSG("Replicate "<<r<<" (seed "<<par::stream_seed(seed,r)<<"): RF Score = "<<std::fixed<<std::setprecision(2)<<results[j].score<<", SPR neighborhood searches: "<<results[j].SPR_rounds);
+        }
+    }
+
+    //rank 0 collects score, supertree and output of every replicate
+    std::string buf;
+    if (!rank_edges || par::rank()==0)
+        for (unsigned int j=0; j<mine.size(); ++j) {
+            std::ostringstream tree_os, out_os;
+            aw::tree2newick(tree_os,results[j].s_tree,results[j].s_taxa);
+            write_result(out_os,results[j],in,g_taxa,inputrees);
+            par::pack(buf,mine[j]); par::pack(buf,results[j].score); par::pack(buf,results[j].SPR_rounds);
+            par::pack(buf,tree_os.str()); par::pack(buf,out_os.str());
+        }
+    std::vector<std::string> bufs;
+    par::gather(buf,bufs,false);
+    std::vector<float> scores(replicates);
+    std::vector<std::string> trees(replicates), outs(replicates);
+    BOOST_FOREACH(std::string &b, bufs)
+        for (std::size_t at=0; at<b.size(); ) {
+            int r; unsigned int rounds;
+            par::unpack(b,at,r); par::unpack(b,at,scores[r]); par::unpack(b,at,rounds);
+            par::unpack(b,at,trees[r]); par::unpack(b,at,outs[r]);
+            if (replicates>1 && r%par::size()!=0)
+                MSG("Replicate "<<r<<" (seed "<<par::stream_seed(seed,r)<<"): RF Score = "<<std::fixed<<std::setprecision(2)<<scores[r]<<", SPR neighborhood searches: "<<rounds);
+        }
+    unsigned int best = 0;   //lowest score, ties go to the first replicate
+    for (unsigned int r=1; r<replicates; ++r)
+        if (scores[r] < scores[best]) best = r;
+    if (replicates>1) MSG("Best replicate: "<<best);
+
+    if (par::rank()==0) {   //outputing input trees and output super tree
+        output << outs[best];
+        if (replicates>1)
+            for (unsigned int r=0; r<replicates; ++r) {
+                output <<"\n[ Replicate "<<r<<" (seed "<<par::stream_seed(seed,r)<<"): Species Tree: Unrooted RF Score = "<<std::fixed<<std::setprecision(2)<<scores[r]<<"]"<< std::endl;
+                output << trees[r] << std::endl; }
     }
 
-    int t4 = clock();
+    const double t4 = par::wtime();
     {   //for timing...
-        long ttime = ((long)(t4-t3))/CLOCKS_PER_SEC;
+        long ttime = (long)(t4-t3);
         int d,h,m,s;
         util::convertTime(ttime,d,h,m,s);
         MSG_nonewline("Total elapsed time: ");
@@ -1419,8 +1365,9 @@ int main(int ac, char* av[]) {
         if(h!=0) MSG_nonewline(h<<"h ");
         if(m!=0) MSG_nonewline(m<<"m ");
         MSG_nonewline(s<<"s ");
-        output <<"\n[ Time "<<d<<"d "<<h<<"h "<<m<<"m "<<s<<"s "<<"]"<< std::endl;
+        if (par::rank()==0) output <<"\n[ Time "<<d<<"d "<<h<<"h "<<m<<"m "<<s<<"s "<<"]"<< std::endl;
     }
+    par::finalize();
 
 
 }
@@ -0,0 +1,210 @@
+/*
+ * File:   parallel.h
+ * Author: ruchi
+ *
+ * Thin wrapper around OpenMP so that the code still compiles (serially)
+ * when the compiler is not called with -fopenmp, and around MPI for the
+ * build with -DWITH_MPI (one process without it)
+ */
+
+#ifndef _PARALLEL_H
+#define	_PARALLEL_H
+
+#include "common.h"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <sstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#include <sys/time.h>
+#endif
+
+namespace par {
+
+    // number of worker threads requested with --threads
+    inline unsigned int &threads_ref() {
+        static unsigned int n = 1;
+        return n;
+    }
+
+    inline unsigned int threads() {
+        return threads_ref();
+    }
+
+    // true if the binary was compiled with OpenMP support
+    inline bool available() {
+        #ifdef _OPENMP
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    inline void set_threads(const unsigned int n) {
+        threads_ref() = (n == 0) ? 1 : n;
+        #ifdef _OPENMP
+        omp_set_num_threads(threads_ref());
+        #endif
+    }
+
+    // true if the caller already runs inside a parallel region
+    inline bool in_parallel() {
+        #ifdef _OPENMP
+        return omp_in_parallel();
+        #else
+        return false;
+        #endif
+    }
+
+    // true if n work items are enough to keep every worker busy with at
+    // least grain items; small loops are cheaper to run serially, and
+    // nested regions would only oversubscribe the workers
+    inline bool worth(const unsigned int n, const unsigned int grain) {
+        return threads() > 1 && n >= grain*threads() && !in_parallel();
+    }
+
+    // wall clock time in seconds; unlike clock() it does not add up the time of the threads
+    inline double wtime() {
+        #ifdef _OPENMP
+        return omp_get_wtime();
+        #else
+        timeval t; gettimeofday(&t, NULL);
+        return t.tv_sec + t.tv_usec*1e-6;
+        #endif
+    }
+
+    // start/stop MPI; messages are printed by rank 0 only
+    inline void init(int *ac, char ***av) {
+        #ifdef WITH_MPI
+        int provided;
+        MPI_Init_thread(ac, av, MPI_THREAD_FUNNELED, &provided);
+        MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank());
+        if (mpi_rank() != 0) stdmsg.quiet = true;
+        #endif
+    }
+
+    inline void finalize() {
+        #ifdef WITH_MPI
+        MPI_Finalize();
+        #endif
+    }
+
+    // rank of this process and number of processes
+    inline int rank() {
+        #ifdef WITH_MPI
+        return mpi_rank();
+        #else
+        return 0;
+        #endif
+    }
+
+    inline int size() {
+        #ifdef WITH_MPI
+        int n; MPI_Comm_size(MPI_COMM_WORLD, &n);
+        return n;
+        #else
+        return 1;
+        #endif
+    }
+
+    // append/read plain values and strings to/from a message buffer
+    template<class T> inline void pack(std::string &buf, const T &v) {
+        buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    inline void pack(std::string &buf, const std::string &v) {
+        pack(buf, (unsigned int)v.size());
+        buf.append(v);
+    }
+
+    template<class T> inline void unpack(const std::string &buf, std::size_t &at, T &v) {
+        memcpy(&v, buf.data()+at, sizeof(T));
+        at += sizeof(T);
+    }
+
+    inline void unpack(const std::string &buf, std::size_t &at, std::string &v) {
+        unsigned int n; unpack(buf, at, n);
+        v.assign(buf, at, n);
+        at += n;
+    }
+
+    // rank 0 sends buf to all ranks
+    inline void bcast(std::string &buf) {
+        #ifdef WITH_MPI
+        unsigned int n = buf.size();
+        MPI_Bcast(&n, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+        std::vector<char> data(buf.begin(), buf.end()); data.resize(n+1);
+        MPI_Bcast(&data[0], n, MPI_CHAR, 0, MPI_COMM_WORLD);
+        buf.assign(&data[0], n);
+        #endif
+    }
+
+    inline void bcast(unsigned int &v) {
+        #ifdef WITH_MPI
+        MPI_Bcast(&v, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+        #endif
+    }
+
+    // with MPI rank 0 reads the whole of is and every rank reads its copy
+    // from copy; without MPI is itself is returned
+    inline std::istream &shared(std::istream &is, std::istringstream &copy) {
+        #ifdef WITH_MPI
+        std::string buf;
+        if (rank() == 0) { std::ostringstream os; os << is.rdbuf(); buf = os.str(); }
+        bcast(buf);
+        copy.str(buf);
+        return copy;
+        #else
+        return is;
+        #endif
+    }
+
+    // the buffers of all ranks, in rank order; on rank 0 only if all_ranks is false
+    inline void gather(const std::string &buf, std::vector<std::string> &bufs, const bool all_ranks) {
+        bufs.clear();
+        #ifdef WITH_MPI
+        const int n = size();
+        int len = buf.size();
+        std::vector<int> lens(n), offs(n);
+        if (all_ranks) MPI_Allgather(&len, 1, MPI_INT, &lens[0], 1, MPI_INT, MPI_COMM_WORLD);
+        else MPI_Gather(&len, 1, MPI_INT, &lens[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+        int total = 0;
+        for (int i=0; i<n; ++i) { offs[i] = total; total += lens[i]; }
+        std::vector<char> data(total+1);
+        std::vector<char> mine(buf.begin(), buf.end()); mine.resize(len+1);
+        if (all_ranks) MPI_Allgatherv(&mine[0], len, MPI_CHAR, &data[0], &lens[0], &offs[0], MPI_CHAR, MPI_COMM_WORLD);
+        else MPI_Gatherv(&mine[0], len, MPI_CHAR, &data[0], &lens[0], &offs[0], MPI_CHAR, 0, MPI_COMM_WORLD);
+        if (all_ranks || rank() == 0)
+            for (int i=0; i<n; ++i) bufs.push_back(std::string(&data[offs[i]], lens[i]));
+        #else
+        bufs.push_back(buf);
+        #endif
+    }
+
+    // seed of an independent random stream of seed; stream 0 is seed itself, the
+    // others are scrambled so that streams of nearby seeds are unrelated. Streams
+    // nest: stream_seed(stream_seed(seed,replicate),task) for the tasks of a replicate
+    inline unsigned int stream_seed(const unsigned int seed, const unsigned int id) {
+        if (id == 0) return seed;
+        unsigned int h = seed ^ (id * 0x9e3779b9u);
+        h ^= h >> 16; h *= 0x85ebca6bu;
+        h ^= h >> 13; h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    // id of the calling worker thread (0 outside of parallel regions)
+    inline unsigned int thread_id() {
+        #ifdef _OPENMP
+        return omp_get_thread_num();
+        #else
+        return 0;
+        #endif
+    }
+
+}
+
+#endif	/* _PARALLEL_H */
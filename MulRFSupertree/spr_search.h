@@ -0,0 +1,1387 @@
+/*
+ * File:   spr_search.h
+ * Author: ruchi
+ *
+ * Evaluation of a single prune edge of the SPR neighborhood of the supertree.
+ * Everything that changes while a prune edge is evaluated (input tree rootings
+ * and the supertree restricted to the leaves of each input tree) is kept in an
+ * SPRWorker, so prune edges can be evaluated by several workers at the same
+ * time. The LCA structures of the input trees are built once and shared.
+ */
+
+#ifndef _SPR_SEARCH_H
+#define	_SPR_SEARCH_H
+
+#include "tree.h"
+#include "tree_traversal.h"
+#include "tree_LCA.h"
+#include "tree_LCA_mapping.h"
+#include "tree_name_map.h"
+#include "tree_subtree_info.h"
+#include "tree_induced.h"
+#include "tree_duplication.h"
+#include "rf_compute.h"
+#include "parallel.h"
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <set>
+#include <string>
+#include <sstream>
+#include <algorithm>
+
+namespace aw {
+
+// an edge {x,px} of the unrooted supertree; y is the other end of the pruned edge
+struct chEdge { unsigned int x, y, px; };
+
+// Weighted scores are sums in fixed point: the weight of an input tree is scaled by
+// 2^WEIGHT_BITS and rounded. A running total then follows the score changes of single
+// input trees exactly, in any order, with no rounding drift against EPSILON.
+const unsigned int WEIGHT_BITS = 20;
+
+inline long long fixed_weight(const float w) {
+    return (long long)floor((double)w*(1<<WEIGHT_BITS)+0.5);
+}
+
+inline float fixed_score(const long long total) {
+    return (float)((double)total/(1<<WEIGHT_BITS));
+}
+
+// weighted score of the input tree scores g_scr
+inline float weighted_score(const std::vector<unsigned int> &g_scr, const std::vector<float> &g_weights) {
+    long long total = 0;
+    for (unsigned int k=0,kEE=g_scr.size(); k<kEE; ++k)
+        total += g_scr[k]*fixed_weight(g_weights[k]);
+    return fixed_score(total);
+}
+
+// unrooted input tree t as a string of global ids that is the same for all trees with
+// the same labelled topology: read from each copy of the smallest global id, children in
+// sorted order, the smallest string is taken
+inline std::string canonical_tree(aw::Tree &t, TreetaxaMap &nmap) {
+    aw::Tree u = t;
+    if(u.degree(0)==2) u.delRoot();
+    std::vector<unsigned int> gids, ids;
+    nmap.gids(gids);
+    nmap.ids(*std::min_element(gids.begin(),gids.end()),ids);
+    std::string best;
+    BOOST_FOREACH(const unsigned int &r, ids) {
+        std::vector<std::string> below(u.node_size());
+        for (aw::Tree::iterator_dfs v=u.begin_dfs(r,NONODE),vEE=u.end_dfs(); v!=vEE; ++v) {
+            if(v.direction!=POSTORDER) continue;
+            std::ostringstream os;
+            if(u.is_leaf(v.idx) && v.idx!=r) os << nmap.gid(v.idx);
+            else {
+                std::vector<std::string> ch;
+                BOOST_FOREACH(const unsigned int &c, u.children(v.idx,v.parent)) ch.push_back(below[c]);
+                std::sort(ch.begin(),ch.end());
+                if(v.idx==r) os << nmap.gid(r);
+                os << '(';
+                for (unsigned int i=0,iEE=ch.size(); i<iEE; ++i) os << (i ? "," : "") << ch[i];
+                os << ')';
+                BOOST_FOREACH(const unsigned int &c, u.children(v.idx,v.parent)) std::string().swap(below[c]);
+            }
+            below[v.idx] = os.str();
+        }
+        if(best.empty() || below[r]<best) best = below[r];
+    }
+    return best;
+}
+
+// input shared by all workers: read only while a SPR neighborhood is evaluated
+struct SPRInput {
+    aw::Tree &s_tree;
+    aw::TreetaxaMap &s_nmap;
+    std::vector<aw::TreetaxaMap> &g_nmaps;
+    std::vector<std::pair<unsigned int,unsigned int> > &g_nodes;
+    std::vector<unsigned int> &rs_int_nodes;
+    std::vector<float> &g_weights;
+    std::vector<long long> g_fixed;       //g_weights in fixed point
+    std::vector<unsigned int> &g_scr;     //input tree scores of the current supertree
+    bool constr;
+    std::vector<boost::dynamic_bitset<> > g_gids;  //taxa (global ids) of each input tree
+    std::vector<char> g_fold;   //input trees whose score changes are not computed, see fold()
+    std::vector<unsigned int> s_one;            //the leaf of s_tree that stands for each global id
+    aw::SubtreeInfoRooted<aw::Tree> s_info;     //subtree intervals of s_tree, see update()
+    //(leaf of s_tree, leaf of the input tree it maps to) of each input tree, the i-th copy
+    //of a taxon to the i-th one; in preorder of s_tree, see update()
+    std::vector<std::vector<std::pair<unsigned int,unsigned int> > > g_leaves;
+    std::vector<unsigned int> s_pre, s_end;     //preorder number of the nodes of s_tree, and past their subtree
+    std::vector<unsigned int> s_order;          //nodes of s_tree in preorder
+    std::vector<unsigned int> s_taxon;          //node of s_tree a leaf stands for: the fake node above a copy, else itself
+    aw::LCA s_lca;
+
+    SPRInput(aw::Tree &s_tree, aw::TreetaxaMap &s_nmap, std::vector<aw::TreetaxaMap> &g_nmaps,
+            std::vector<std::pair<unsigned int,unsigned int> > &g_nodes, std::vector<unsigned int> &rs_int_nodes,
+            std::vector<float> &g_weights, std::vector<unsigned int> &g_scr, bool constr)
+        : s_tree(s_tree), s_nmap(s_nmap), g_nmaps(g_nmaps), g_nodes(g_nodes), rs_int_nodes(rs_int_nodes),
+          g_weights(g_weights), g_scr(g_scr), constr(constr) {
+        unsigned int n = 0;
+        std::vector<std::vector<unsigned int> > gids(g_nmaps.size());
+        for (unsigned int k=0,kEE=g_nmaps.size(); k<kEE; ++k) {
+            g_nmaps[k].gids(gids[k]);
+            BOOST_FOREACH(const unsigned int &g, gids[k]) if(g>=n) n = g+1;
+        }
+        g_gids.assign(g_nmaps.size(),boost::dynamic_bitset<>(n));
+        for (unsigned int k=0,kEE=g_nmaps.size(); k<kEE; ++k)
+            BOOST_FOREACH(const unsigned int &g, gids[k]) g_gids[k].set(g);
+        s_one.resize(n);
+        for (unsigned int g=0; g<n; ++g) s_one[g] = s_nmap.one_id(g);
+        BOOST_FOREACH(const float &w, g_weights) g_fixed.push_back(fixed_weight(w));
+        g_fold.assign(g_weights.size(),0);
+        g_leaves.resize(g_nmaps.size());
+        for (unsigned int k=0,kEE=g_nmaps.size(); k<kEE; ++k) {
+            std::set<unsigned int> unq;
+            g_nmaps[k].unq_gids(unq);
+            std::vector<unsigned int> s_ids, g_ids;
+            BOOST_FOREACH(const unsigned int &g, unq) {
+                s_ids.clear(); g_ids.clear();
+                s_nmap.ids(g,s_ids); g_nmaps[k].ids(g,g_ids);
+                for (unsigned int i=0,iEE=std::min(s_ids.size(),g_ids.size()); i<iEE; ++i)
+                    g_leaves[k].push_back(std::make_pair(s_ids[i],g_ids[i]));
+            }
+        }
+    }
+
+    // leave out input trees whose score changes follow from others: a tree with a single
+    // internal node scores the same on every supertree, and a tree with the same topology
+    // as an earlier one scores as that one does, which takes its weight. Fixed point
+    // weights add up exactly, so the totals stay the same. Returns the trees left.
+    inline unsigned int fold(std::vector<aw::Tree> &g_trees) {
+        std::map<std::string,unsigned int> first;
+        unsigned int left = 0;
+        for (unsigned int k=0,kEE=g_trees.size(); k<kEE; ++k) {
+            if(g_nodes[k].first<=1) { g_fold[k] = 1; continue; }
+            std::map<std::string,unsigned int>::iterator i = first.insert(std::make_pair(canonical_tree(g_trees[k],g_nmaps[k]),k)).first;
+            if(i->second!=k) {
+                g_fixed[i->second] += g_fixed[k]; g_fixed[k] = 0;
+                g_fold[k] = 1; }
+            else ++left;
+        }
+        return left;
+    }
+
+    // the supertree changed: number its subtrees again
+    inline void update() {
+        s_info.create(s_tree);
+        s_lca.create(s_tree);
+        s_pre.assign(s_tree.node_size(),NONODE); s_end.assign(s_tree.node_size(),NONODE);
+        s_order.clear(); s_taxon.assign(s_tree.node_size(),NONODE);
+        unsigned int n = 0;
+        TREE_DFS2(v,s_tree) {
+            if(v.direction==PREORDER) {
+                s_pre[v.idx] = n++; s_order.push_back(v.idx);
+                if(s_tree.is_leaf(v.idx)) s_taxon[v.idx] = s_tree.is_fake(v.parent) ? v.parent : v.idx; }
+            else if(v.direction==POSTORDER) s_end[v.idx] = n;
+        }
+        #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_leaves.size(),2))
+        for (unsigned int k=0; k<g_leaves.size(); ++k) {
+            std::vector<std::pair<unsigned int,unsigned int> > &l = g_leaves[k];
+            for (unsigned int i=0,iEE=l.size(); i<iEE; ++i) l[i].first = s_pre[l[i].first];
+            std::sort(l.begin(),l.end());
+            for (unsigned int i=0,iEE=l.size(); i<iEE; ++i) l[i].first = s_order[l[i].first];
+        }
+    }
+
+    // true if node u of s_tree is in the subtree of v
+    inline bool below(const unsigned int u, const unsigned int v) const {
+        return s_pre[v]<=s_pre[u] && s_pre[u]<s_end[v];
+    }
+};
+
+// supertree with the pruned subtree regrafted above reg_leaf, the start of a move-down
+struct SPRMove {
+    aw::Tree us_tree;
+    unsigned int x;                 //subtree of s_tree on one side of the prune edge
+    bool reg_x;                     //true if the x side is pruned
+    boost::dynamic_bitset<> x_gids; //global ids whose leaf in s_tree is below x
+    unsigned int prn_side, rgft_side, reg_leaf;
+    std::vector<unsigned int> changed;  //nodes whose edges the regraft changed
+};
+
+// global ids of the taxa on the pruned side of m
+inline boost::dynamic_bitset<> pruned_gids(const SPRMove &m) {
+    return m.reg_x ? m.x_gids : ~m.x_gids;
+}
+
+// true if leaf l of s_tree is on the pruned side of m
+inline bool pruned_leaf(SPRInput &in, SPRMove &m, const unsigned int l) {
+    return (in.s_tree.degree(l)==1 && in.s_info.is_contained(l,m.x)) == m.reg_x;
+}
+
+// a supertree met during a move-down and its score; the tree itself is rebuilt from
+// the move by candidate_tree()
+struct SPRCandidate {
+    float score;
+    unsigned int pos;       // position in the move-down, 0 is the regraft of the root
+    unsigned int root, root_adj;    // root edge of the copy of the supertree it was met on
+};
+
+// cluster sizes of an input tree for its current rooting
+inline void gene_clusters(aw::Tree &g_tree) {
+    unsigned int count;
+    TREE_POSTORDER2(v, g_tree)
+        if (g_tree.is_leaf(v.idx))
+            g_tree.update_clst(v.idx,1);
+        else {  count = 0;
+            BOOST_FOREACH(const unsigned int &c,g_tree.children(v.idx,v.parent))
+                count += g_tree.return_clstSz(c);
+            g_tree.update_clst(v.idx,count); }
+}
+
+// root an input tree by leaf r, keeping its cluster sizes. Only the nodes on the path
+// between the old and the new root leaf turn around: the new cluster of such a node is
+// the total minus the old cluster of its neighbour towards r.
+inline void reroot_gene(aw::Tree &g_tree, const unsigned int r) {
+    const unsigned int total = g_tree.return_clstSz(0);
+    std::vector<unsigned int> path;     //parents of r up to the child of the root
+    for (unsigned int v=r;;) {
+        unsigned int p = NONODE;        //the parent has the largest cluster
+        BOOST_FOREACH(const unsigned int &w, g_tree.adjacent(v))
+            if(p==NONODE || g_tree.return_clstSz(w) > g_tree.return_clstSz(p)) p = w;
+        if(p==0) break;
+        path.push_back(v = p);
+    }
+    g_tree.rootBy(r);
+    for (unsigned int i=path.size(); i>0; --i)
+        g_tree.update_clst(path[i-1],total - g_tree.return_clstSz(i>1 ? path[i-2] : r));
+}
+
+// prune the subtree of edge e and regraft it above a leaf on the other side
+// false if the edge has to be skipped (constraints or nothing to move)
+inline bool spr_prepare(SPRInput &in, const chEdge &e, const bool reg_x, SPRMove &m) {
+    aw::Tree &s_tree = in.s_tree;
+    const unsigned int x = e.x, y = e.y, px = e.px;
+
+    m.us_tree = s_tree;
+    m.us_tree.delRoot();
+
+    //the x side is the subtree of x in s_tree: y is parent of x or both are
+    //siblings (for edge having root (0)); the taxa there are marked in x_gids
+    m.x = x; m.reg_x = reg_x;
+    m.x_gids.resize(in.s_one.size());
+    for (unsigned int g=0,gEE=in.s_one.size(); g<gEE; ++g)
+        m.x_gids[g] = in.s_info.is_contained(in.s_one[g],x);
+    unsigned int reg_leaf = NONODE;
+
+    //for generalization
+    unsigned int prn_side, rgft_side;
+    if(reg_x) {
+        prn_side=x; rgft_side=y;
+    } else {
+        prn_side=y; rgft_side=x;}
+
+    if(in.constr) {  //FOR CONSTRAINT ----------------------------------------------------------------
+        if(px!=y) {
+            if(s_tree.constr_num(x)!= NONODE && s_tree.constr_num(y)!=NONODE) { return false;
+            } else if(s_tree.constr_num(x)!=NONODE) {
+                if(prn_side==y) return false;
+            } else if(s_tree.constr_num(y)!=NONODE) {
+                if(prn_side==x) return false;
+            }
+        }
+        else {
+            if(s_tree.constr_num(x) != NONODE) {  //x side can be pruned but no y side since x makes a clade
+                if(s_tree.constr_num(y) != NONODE)  ERROR_exit("ERROR");
+                if(prn_side==y)  return false;
+            } else if(s_tree.constr_num(y) != NONODE) {  //y side can be pruned but no x side since y makes a clade
+                if(s_tree.constr_num(x) != NONODE)  ERROR_exit("ERROR");
+                if(prn_side==x)  return false;
+            } else if(s_tree.in_cld(x)==s_tree.in_cld(y) && s_tree.constr_num(x)==NONODE && s_tree.constr_num(y)==NONODE) {
+                //LIMITED regraft
+                if(prn_side==y) return false;
+            }
+        }
+    }
+
+    TREE_FOREACHLEAF(v2,s_tree) { // find a leaf that is not multiple
+        bool flgg = false;
+        if(!pruned_leaf(in,m,v2)) {
+            std::vector<unsigned int> ch;
+            s_tree.adjacent(v2,ch);
+            if(ch.size()>1) ERROR_exit("Leaf has more than one adjacent nodes!");
+            if(!s_tree.is_fake(ch[0])) {
+                reg_leaf=v2;
+                flgg = true; }
+            else {
+                reg_leaf = ch[0];
+                flgg = true; }
+        }
+        if(flgg) {
+            if(in.constr) {  //FOR CONSTRAINT ----------------------------------------------------------------
+                if(s_tree.constr_num(prn_side)!=NONODE) {   //can go any where but in an another clade
+                    if(s_tree.in_cld(reg_leaf)!=NONODE)
+                        continue;
+                } else {
+                    if(s_tree.in_cld(prn_side)!=s_tree.in_cld(reg_leaf))
+                        continue;
+                }
+            }
+            break;
+        }
+    }
+
+    if(reg_leaf==NONODE) ERROR_exit("Uninitialised reg_leaf");
+    m.prn_side = prn_side; m.rgft_side = rgft_side; m.reg_leaf = reg_leaf;
+    m.changed.clear();
+    m.changed.push_back(rgft_side); m.changed.push_back(reg_leaf);
+    m.changed.insert(m.changed.end(),m.us_tree.adjacent(rgft_side).begin(),m.us_tree.adjacent(rgft_side).end());
+    if(m.us_tree.spr_to_edge(prn_side,rgft_side,reg_leaf) != 0) return false;   //Regraaft XX above reg_leaf in YY
+    m.changed.insert(m.changed.end(),m.us_tree.adjacent(rgft_side).begin(),m.us_tree.adjacent(rgft_side).end());
+    return true;
+}
+
+// leaf of each input tree to root it by for the move m: the current root leaf if it
+// lies on the regraft side, otherwise the first leaf there; NONODE if the input tree
+// has no leaves on one side and is not affected by m
+inline void spr_roots(SPRInput &in, SPRMove &m, std::vector<aw::Tree> &g_trees, std::vector<unsigned int> &root_at) {
+    root_at.assign(g_trees.size(),NONODE);
+    #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+    for (unsigned int k=0; k<g_trees.size(); ++k) {
+        //affected only with taxa on both sides
+        if(!in.g_gids[k].intersects(m.x_gids) || in.g_gids[k].is_subset_of(m.x_gids)) continue;
+
+        unsigned int old_root = NONODE;
+        BOOST_FOREACH(const unsigned int &w, g_trees[k].adjacent(0))
+            if(g_trees[k].is_leaf(w)) old_root = w;  //Assuming input trees have more than 2 leaf3
+
+        //check if we really need to reroot input tree
+        if(m.x_gids[in.g_nmaps[k].gid(old_root)] != m.reg_x) {
+            root_at[k] = old_root;  continue; }
+        TREE_FOREACHLEAF(w,g_trees[k])
+            if(m.x_gids[in.g_nmaps[k].gid(w)] != m.reg_x) {
+                root_at[k] = w;  break; }
+    }
+}
+
+// the root edge of the supertree t for input tree k rooted by its leaf rootAt: root is
+// the leaf of t that maps to rootAt, root_adj the node next to the first copy of its taxon
+inline void root_edge(SPRInput &in, aw::Tree &t, const unsigned int k, const unsigned int rootAt,
+        unsigned int &root, unsigned int &root_adj) {
+    std::vector<unsigned int> child;
+    in.s_nmap.ids(in.g_nmaps[k].gid(rootAt),child);
+    std::vector<unsigned int> ch1;
+    t.adjacent(child[0],ch1);
+    if(ch1.size()>1) ERROR_exit("Leaf has more than one adjacent nodes!");
+    root_adj = ch1[0];
+    root = NONODE;
+    for (unsigned int i=0,iEE=in.g_leaves[k].size(); i<iEE; ++i)
+        if(in.g_leaves[k][i].second==rootAt) root = in.g_leaves[k][i].first;
+}
+
+// a step of the move-down: the pruned subtree goes from edge {a,b} to edge {b,c}
+struct RegraftStep {
+    unsigned int a, b, c;
+};
+
+// positions of the move-down of m: the pruned subtree goes through the regraft side of
+// us_tree, rooted by reg_leaf, and is moved from edge {a1,b1} to edge {b1,c1} at each step
+class MoveDown {
+    protected: SPRInput &in;
+    protected: aw::Tree &us_tree;
+    protected: const unsigned int prn_side, rgft_side, reg_leaf, reg_leaf_adj;
+    protected: aw::SubtreeParent<aw::Tree> us_parent;
+    protected: aw::Tree::iterator_dfs p, pEE;
+    protected: unsigned int last_a, last_b, last_c;
+    protected: std::string last_dir;
+    protected: bool fake, done;
+
+    public: MoveDown(SPRInput &in_, SPRMove &m, const unsigned int reg_leaf_adj_) :
+            in(in_), us_tree(m.us_tree), prn_side(m.prn_side), rgft_side(m.rgft_side), reg_leaf(m.reg_leaf),
+            reg_leaf_adj(reg_leaf_adj_), p(m.us_tree.begin_dfs(reg_leaf_adj_,m.rgft_side)), pEE(m.us_tree.end_dfs()),
+            fake(false) {
+        us_parent.create(us_tree);
+        done = us_tree.is_fake(reg_leaf_adj) || us_tree.is_leaf(reg_leaf_adj);
+    }
+
+    // the next position; false at the end of the move-down
+    public: inline bool next(unsigned int &a1, unsigned int &b1, unsigned int &c1) {
+        if(done) return false;
+        for (; p!=pEE; ++p) {
+            if(p.idx == reg_leaf_adj) continue;
+
+            if(fake && !us_tree.is_fake(p.idx)) continue;
+
+            if(in.constr) {  //FOR CONSTRAINT..............
+                if(us_tree.constr_num(prn_side)!=NONODE) { //x is root of a clade
+                    if(us_tree.in_cld(p.idx)!=NONODE && us_tree.constr_num(p.idx)==NONODE)
+                        continue;
+                } else if(us_tree.constr_num(prn_side)==NONODE && us_tree.in_cld(prn_side)!=NONODE) { //x inside a clade
+                    if(us_tree.in_cld(prn_side)!=us_tree.in_cld(p.idx))
+                        continue;
+                } else {  //x is no where clade
+                    if(us_tree.in_cld(p.idx)!=NONODE && us_tree.constr_num(p.idx)==NONODE)
+                        continue;
+                }
+            }
+
+            //Moving subtree X from {a1,b1} to edge {b1,c1}
+            switch (p.direction) {
+                case aw::PREORDER: {
+                    if(p.parent != reg_leaf_adj) {
+                        if(last_dir=="PRE") {
+                            a1 = last_b; b1 = last_c; c1 = p.idx;
+                        } else {
+                            a1 = last_c; b1 = last_b; c1 = p.idx;
+                        }
+                    } else { //in the start of traversal
+                        a1 = reg_leaf; b1 = reg_leaf_adj; c1 = p.idx;
+                    }
+                    last_dir = "PRE";
+                    if(us_tree.is_fake(p.idx))
+                        fake = !fake;
+                } break;
+
+                case aw::POSTORDER: {
+                    if(last_dir=="PRE") {
+                        a1 = last_c; b1 = last_b; c1 = last_a;
+                    } else {
+                        a1 = last_b; b1 = last_c; c1 = us_parent.parent(last_c);
+                        if(c1 == rgft_side) c1 = reg_leaf;
+                    }
+                    last_dir = "POST";
+                    if(us_tree.is_fake(p.idx)) fake = !fake;
+                } break;
+                default: {continue;} break;
+            }
+
+            last_a = a1; last_b = b1; last_c = c1;
+            if(us_tree.is_fake(b1) && us_tree.is_leaf(c1))
+                ERROR_exit("Wrong move-down");
+            ++p;
+            return true;
+        }
+        return false;
+    }
+};
+
+// move the regraft side node rgft_side of the rooted copy t with the pruned subtree from
+// edge {a1,b1} to edge {b1,c1}. Returns which of the three ways t is rooted relative to
+// the move applies; sib is then the sibling of c1 (1) or of rgft_side (3) before the move.
+inline int move_regraft(aw::Tree &t, aw::SubtreeParent<aw::Tree> &parents, const unsigned int a1,
+        const unsigned int b1, const unsigned int c1, const unsigned int rgft_side, unsigned int &sib) {
+    if(parents.parent(c1)==b1 && parents.parent(b1)==rgft_side) {
+        unsigned int real_a1;
+        if(parents.parent(rgft_side)==a1) real_a1 = a1;
+        else if(parents.parent(rgft_side)==0) real_a1=0;
+        else ERROR_exit("Error in the tree");
+
+        sib = parents.sibling_binary(c1);
+        t.moveSub(real_a1,b1,c1,rgft_side);  //update tree
+        parents.tPtrUpdate(t); //update parent-child relationships
+        parents.update(c1,rgft_side);
+        parents.update(rgft_side,b1);
+        parents.update(b1,real_a1);
+        return 1;
+    } else if(parents.parent(rgft_side)==b1 && parents.parent(c1)==b1) {
+        sib = NONODE;
+        t.moveSub(a1,b1,c1,rgft_side);  //update tree
+        parents.tPtrUpdate(t); //update parent-child relationships
+        parents.update(c1,rgft_side);
+        parents.update(rgft_side,b1);
+        parents.update(a1,b1);
+        return 2;
+    } else if(parents.parent(a1)==rgft_side && parents.parent(rgft_side)==b1) {
+        unsigned int real_c1;
+        if(parents.parent(b1)==c1) real_c1 = c1;
+        else if(parents.parent(b1)==0) real_c1=0;
+        else ERROR_exit("Error in the tree");
+
+        sib = parents.sibling_binary(rgft_side);
+        t.moveSub(a1,b1,real_c1,rgft_side);  //update tree
+        parents.tPtrUpdate(t); //update parent-child relationships
+        parents.update(b1,rgft_side);
+        parents.update(rgft_side,real_c1);
+        parents.update(a1,b1);
+        return 3;
+    }
+    ERROR_exit("SOME ERROR");
+    return 0;
+}
+
+// the node of the regraft side next to reg_leaf in the start tree of m
+inline unsigned int regraft_start(SPRMove &m) {
+    unsigned int reg_leaf_adj = NONODE;
+    BOOST_FOREACH(const unsigned int &w, m.us_tree.adjacent(m.rgft_side))
+        if(w!=m.reg_leaf && w!=m.prn_side) reg_leaf_adj = w;
+    return reg_leaf_adj;
+}
+
+// the supertree of candidate c of the prune edge e: the moves of the move-down up to
+// c.pos are made again on the copy of the supertree it was met on
+inline void candidate_tree(SPRInput &in, const chEdge &e, const bool reg_x, const SPRCandidate &c, aw::Tree &out) {
+    SPRMove m;
+    if(!spr_prepare(in,e,reg_x,m)) ERROR_exit("Candidate of a skipped prune edge");
+    const unsigned int reg_leaf_adj = regraft_start(m);
+    if(c.pos>0) {
+        out = m.us_tree;
+        out.addRoot(c.root,c.root_adj);
+    }
+    m.us_tree.addRoot(m.reg_leaf,m.rgft_side);
+    if(c.pos==0) { out.swap(m.us_tree); return; }
+    aw::SubtreeParent<aw::Tree> parents; parents.create(out);
+    MoveDown md(in,m,reg_leaf_adj);
+    unsigned int a1, b1, c1, sib;
+    for (unsigned int i=0; i<c.pos; ++i) {
+        if(!md.next(a1,b1,c1)) ERROR_exit("Candidate beyond the move-down");
+        move_regraft(out,parents,a1,b1,c1,m.rgft_side,sib);
+    }
+}
+
+// the given nodes of a rooted tree and all their ancestors, each once, children before parents
+inline void with_ancestors(aw::SubtreeParent<aw::Tree> &parents, const std::vector<unsigned int> &nodes, std::vector<unsigned int> &out) {
+    std::vector<std::pair<unsigned int,unsigned int> > up;     //(depth, node)
+    std::vector<unsigned int> path;
+    BOOST_FOREACH(const unsigned int &v, nodes) {
+        path.clear();
+        for (unsigned int u=v; u!=NONODE; u=parents.parent(u)) path.push_back(u);
+        for (unsigned int i=0,iEE=path.size(); i<iEE; ++i)
+            up.push_back(std::make_pair(iEE-1-i,path[i]));
+    }
+    std::sort(up.begin(),up.end());
+    out.clear();
+    for (unsigned int i=up.size(); i>0; --i)
+        if(i==up.size() || up[i-1]!=up[i]) out.push_back(up[i-1].second);
+}
+
+// the node of the input tree with the cluster of a supertree node mapped to g with c
+// leaves; NONODE if the cluster is not one that counts for the score
+inline unsigned int supported(aw::Tree &g_tree, const unsigned int g, const unsigned int c) {
+    if(g==NONODE || g_tree.is_leaf(g) || g==g_tree.root || c!=g_tree.return_clstSz(g)) return NONODE;
+    return g;
+}
+
+// a supertree node no longer supports g / supports g now; returns the score change
+inline int take_support(aw::Tree &g_tree, const unsigned int g) {
+    if(g==NONODE) return 0;
+    g_tree.update_score(g,g_tree.return_score(g)-1);
+    return g_tree.return_score(g)==0 ? 2 : 0;
+}
+inline int give_support(aw::Tree &g_tree, const unsigned int g) {
+    if(g==NONODE) return 0;
+    g_tree.incr_score(g,1);
+    return g_tree.return_score(g)==1 ? -2 : 0;
+}
+
+// The supertree restricted to some of its leaves: the leaves, their LCAs in s_tree and
+// the parents when rooted by one of the leaves. A top with two children is no node of
+// the unrooted tree, its children are joined. O(m log m) for m leaves.
+struct RestrictedTree {
+    std::vector<unsigned int> node, pre;        //nodes of s_tree in preorder and their preorder numbers
+    std::vector<unsigned int> leaf, leaf_pre;   //the leaves alone
+    std::vector<char> tip;                      //leaves
+    std::vector<unsigned int> s_par, r_par;     //parent in s_tree and rooted by root (NONODE for none)
+    std::vector<unsigned int> cnt, map;         //rooted by root: input tree leaves below and their LCA
+    std::vector<unsigned int> own, with;        //input tree node supported without / with the pruned subtree
+    unsigned int root, joined[2];               //root and the children of the top if it is left out
+    bool cut;                                   //top left out
+
+    // the tree of leaves, (leaf of s_tree, its input tree leaf or NONODE) in preorder, rooted
+    // by r. A leaf given more than once is a taxon with that many copies in the input tree.
+    template<class L> inline void create(SPRInput &in, const std::vector<std::pair<unsigned int,unsigned int> > &leaves,
+            const unsigned int r, L &g_lca) {
+        std::vector<std::pair<unsigned int,unsigned int> > nodes;     //(preorder number, node)
+        for (unsigned int i=0,iEE=leaves.size(); i<iEE; ++i) {
+            nodes.push_back(std::make_pair(in.s_pre[leaves[i].first],leaves[i].first));
+            if(i>0) {
+                const unsigned int a = in.s_lca.lca(leaves[i-1].first,leaves[i].first);
+                nodes.push_back(std::make_pair(in.s_pre[a],a)); }
+        }
+        std::sort(nodes.begin(),nodes.end());
+        nodes.erase(std::unique(nodes.begin(),nodes.end()),nodes.end());
+        const unsigned int n = nodes.size();
+        node.resize(n); pre.resize(n); tip.assign(n,0); s_par.assign(n,NONODE);
+        cnt.assign(n,0); map.assign(n,NONODE);
+        leaf.clear(); leaf_pre.clear();
+        std::vector<unsigned int> stack;
+        for (unsigned int i=0,l=0; i<n; ++i) {
+            pre[i] = nodes[i].first; node[i] = nodes[i].second;
+            if(l<leaves.size() && leaves[l].first==node[i]) {
+                tip[i] = 1; leaf.push_back(node[i]); leaf_pre.push_back(pre[i]);
+                for (; l<leaves.size() && leaves[l].first==node[i]; ++l)
+                    if(leaves[l].second!=NONODE) { ++cnt[i]; map[i] = g_lca.lca(map[i],leaves[l].second); }
+            }
+            while(!stack.empty() && !in.below(node[i],node[stack.back()])) stack.pop_back();
+            if(!stack.empty()) s_par[i] = stack.back();
+            stack.push_back(i);
+        }
+        unsigned int c = 0;
+        for (unsigned int i=1; i<n; ++i)
+            if(s_par[i]==0) { if(c<2) joined[c] = i; ++c; }
+        cut = c==2 && !tip[0];
+
+        //rooted by r: the parents of the ancestors of r turn around
+        root = index(in,r);
+        r_par = s_par;
+        std::vector<char> path(n,0);
+        for (unsigned int v=root,prev=NONODE; v!=NONODE; ) {
+            const unsigned int up = s_par[v];
+            r_par[v] = prev; path[v] = 1;
+            prev = v; v = up;
+        }
+        if(cut) {
+            r_par[path[joined[0]] ? joined[1] : joined[0]] = r_par[0];
+            r_par[0] = NONODE; }
+
+        //children before parents: the others bottom up, then the ancestors of r top down
+        for (unsigned int i=n; i>0; --i) if(!path[i-1]) add(i-1,g_lca);
+        for (unsigned int i=0; i<n; ++i) if(path[i] && i!=root) add(i,g_lca);
+    }
+
+    // a node with its own and its parents' supported nodes, not the root or a top left out
+    inline bool counts(const unsigned int i) const {
+        return i!=root && !(cut && i==0);
+    }
+
+    // position of node v of s_tree; NONODE if it is no node here
+    inline unsigned int index(SPRInput &in, const unsigned int v) const {
+        const std::vector<unsigned int>::const_iterator i = std::lower_bound(pre.begin(),pre.end(),in.s_pre[v]);
+        return i!=pre.end() && *i==in.s_pre[v] ? i-pre.begin() : NONODE;
+    }
+
+    // Class of the regraft position on edge {p,q} of the supertree without the pruned
+    // subtree, if this is the tree of the leaves on the regraft side: 2u for the edge of u
+    // and its parent, 2a+1 for node a. A part of the supertree without these leaves hangs
+    // at one edge or node of this tree, which has the same clusters for all positions there.
+    inline unsigned int position(SPRInput &in, const unsigned int p, const unsigned int q) const {
+        unsigned int z = p;     //the end of the edge whose subtree in s_tree is on one side only
+        bool across = false;    //the edge joins two children of a node left out of s_tree
+        if(in.below(q,p)) z = q;
+        else if(!in.below(p,q)) across = true;
+        const unsigned int n = leaf.size();
+        unsigned int lo, hi;
+        range(in,z,lo,hi);
+        if(lo<hi && hi-lo<n) return edge_above(index(in,in.s_lca.lca(leaf[lo],leaf[hi-1])));
+        if(!across && lo==hi) {
+            //the lowest ancestor of z with leaves below it
+            unsigned int w = NONODE;
+            if(lo>0) w = in.s_lca.lca(z,leaf[lo-1]);
+            if(lo<n) {
+                const unsigned int w2 = in.s_lca.lca(z,leaf[lo]);
+                if(w==NONODE || in.s_pre[w2]>in.s_pre[w]) w = w2; }
+            range(in,w,lo,hi);
+            if(hi-lo<n) {
+                const unsigned int i = index(in,w);
+                if(i!=NONODE) return 2*i+1;
+                return edge_above(index(in,in.s_lca.lca(leaf[lo],leaf[hi-1])));
+            }
+        }
+        return cut ? edge(joined[0],joined[1]) : 1;
+    }
+
+    // input tree nodes the supertree supports in class c and not in the other classes at
+    // node a: relative to the parents of a holding the pruned subtree, the edge of a adds
+    // the clusters of a without and with it, node a the one with it, and the edge of a
+    // child u the ones of a and u with it
+    inline void items(const unsigned int a, const unsigned int c, unsigned int &g1, unsigned int &g2) const {
+        if(c==2*a+1) { g1 = with[a]; g2 = NONODE; }
+        else if(c==2*a) { g1 = own[a]; g2 = with[a]; }
+        else if(c%2==0 && r_par[c/2]==a) { g1 = with[a]; g2 = with[c/2]; }
+        else ERROR_exit("Wrong move-down");
+    }
+
+    protected: template<class L> inline void add(const unsigned int i, L &g_lca) {
+        if(cut && i==0) return;
+        const unsigned int p = r_par[i];
+        cnt[p] += cnt[i];
+        map[p] = g_lca.lca(map[p],map[i]);
+    }
+
+    // leaves in the subtree of v in s_tree: leaf[lo..hi)
+    protected: inline void range(SPRInput &in, const unsigned int v, unsigned int &lo, unsigned int &hi) const {
+        lo = std::lower_bound(leaf_pre.begin(),leaf_pre.end(),in.s_pre[v]) - leaf_pre.begin();
+        hi = std::lower_bound(leaf_pre.begin(),leaf_pre.end(),in.s_end[v]) - leaf_pre.begin();
+    }
+
+    protected: inline unsigned int edge(const unsigned int u, const unsigned int v) const {
+        return 2*(r_par[u]==v ? u : v);
+    }
+
+    protected: inline unsigned int edge_above(const unsigned int u) const {
+        const unsigned int p = s_par[u];
+        return edge(u, cut && p==0 ? joined[u==joined[0] ? 1 : 0] : p);
+    }
+};
+
+// per-worker state of the input trees and of the supertree restricted to each of them
+class SPRWorker {
+    public: std::vector<aw::Tree> g_trees;
+    public: std::vector<aw::RootedLCA> g_lca;
+    public: std::vector<bool> treeEft;
+
+    // The move-down of evaluate for input tree k runs on rs_trees[k], the supertree without
+    // the pruned subtree restricted to the leaves k maps to, of O(m) nodes for m leaves of k.
+    // A taxon is one leaf there with the number of copies k has, and the LCA of these in k,
+    // in place of the star of copies of s_tree; the move-down never regrafts inside a star.
+    // Every position is in the class of an edge or a node of it (RestrictedTree::position),
+    // and the clusters that count for the score only change from one class to the next. A
+    // step of the move-down goes from one edge of the supertree to the next one through
+    // their common node, so that only happens at the steps through a node of rs_trees[k].
+    protected: std::vector<RestrictedTree> rs_trees;
+    protected: std::vector<unsigned int> start;             //class of the start of the move-down
+    protected: std::vector<RegraftStep> steps;              //positions of the move-down
+    protected: std::vector<unsigned int> through_first, through;  //steps through node b: through[through_first[b]..through_first[b+1])
+    protected: std::vector<long long> delta;                //score change of each of them
+
+    // rs_trees[k] for the move m, with the input tree rooted by its leaf mapped to leaf r
+    // of the supertree, and the score of k at the start of the move-down. The clusters of
+    // the pruned subtree are the same at all positions; only its leaves and LCA count.
+    protected: inline unsigned int restrict_to(SPRInput &in, SPRMove &m, const unsigned int k, const unsigned int r,
+            const unsigned int reg_leaf_adj) {
+        aw::Tree &g_tree = g_trees[k];
+        RestrictedTree &t = rs_trees[k];
+        std::vector<std::pair<unsigned int,unsigned int> > kept, pruned;
+        bool marked = false;    //the pruned side is rooted by rgft_side, where it hangs
+        for (unsigned int i=0,iEE=in.g_leaves[k].size(); i<iEE; ++i) {
+            std::pair<unsigned int,unsigned int> l = in.g_leaves[k][i];
+            const bool prn = pruned_leaf(in,m,l.first);
+            //the copies of a taxon are one leaf, but for the taxon r is a copy of
+            if(in.s_taxon[l.first]!=in.s_taxon[r]) l.first = in.s_taxon[l.first];
+            if(!prn) { kept.push_back(l); continue; }
+            if(!marked && in.s_pre[m.rgft_side]<in.s_pre[l.first]) {
+                pruned.push_back(std::make_pair(m.rgft_side,(unsigned int)NONODE)); marked = true; }
+            pruned.push_back(l);
+        }
+        if(!marked) pruned.push_back(std::make_pair(m.rgft_side,(unsigned int)NONODE));
+
+        TREE_FOREACHNODE(v,g_tree) g_tree.init_score(v);
+        unsigned int m_prn = NONODE, c_prn = 0;
+        {   RestrictedTree p;
+            p.create(in,pruned,m.rgft_side,g_lca[k]);
+            for (unsigned int i=0,iEE=p.node.size(); i<iEE; ++i) {
+                if(!p.counts(i)) continue;
+                give_support(g_tree,supported(g_tree,p.map[i],p.cnt[i]));
+                if(p.r_par[i]==p.root) { m_prn = p.map[i]; c_prn = p.cnt[i]; }
+            }
+        }
+
+        t.create(in,kept,r,g_lca[k]);
+        const unsigned int n = t.node.size();
+        t.own.assign(n,NONODE); t.with.assign(n,NONODE);
+        for (unsigned int i=0; i<n; ++i)
+            if(t.counts(i)) {
+                t.own[i] = supported(g_tree,t.map[i],t.cnt[i]);
+                t.with[i] = supported(g_tree,g_lca[k].lca(t.map[i],m_prn),t.cnt[i]+c_prn); }
+
+        //the pruned subtree regrafted above reg_leaf: the parents of its position hold it
+        const unsigned int s = t.position(in,m.reg_leaf,reg_leaf_adj);
+        std::vector<char> holds(n,0);
+        for (unsigned int v = s%2 ? s/2 : t.r_par[s/2]; v!=t.root; v=t.r_par[v]) holds[v] = 1;
+        for (unsigned int i=0; i<n; ++i)
+            if(t.counts(i)) give_support(g_tree,holds[i] ? t.with[i] : t.own[i]);
+        if(s%2==0) give_support(g_tree,t.with[s/2]);
+        start[k] = s;
+
+        unsigned int score = 0;
+        TREE_FOREACHNODE(v,g_tree)
+            if(!g_tree.is_leaf(v) && g_tree.root!=v && g_tree.return_score(v)==0) score += 2;
+        return score + in.rs_int_nodes[k] - in.g_nodes[k].first;
+    }
+
+    // most the score of input tree k can drop over the move-down: a node of the input tree
+    // that no supertree node supports now gets support only from own or with
+    protected: inline unsigned int best_gain(const unsigned int k) {
+        aw::Tree &g_tree = g_trees[k];
+        const RestrictedTree &t = rs_trees[k];
+        std::vector<char> seen(g_tree.node_size(),0);
+        unsigned int gain = 0;
+        for (unsigned int i=0,iEE=t.node.size(); i<iEE; ++i) {
+            if(!t.counts(i)) continue;
+            const unsigned int g[2] = {t.own[i], t.with[i]};
+            for (unsigned int j=0; j<2; ++j)
+                if(g[j]!=NONODE && !seen[g[j]] && g_tree.return_score(g[j])==0) { seen[g[j]] = 1; gain += 2; }
+        }
+        return gain;
+    }
+
+    // add the score changes of the affected trees order[b..e) at all steps to delta
+    protected: inline void add_changes(SPRInput &in, const std::vector<std::pair<long long,unsigned int> > &order,
+            const unsigned int b, const unsigned int e) {
+        #pragma omp parallel if(par::worth(e-b,32))
+        {
+            std::vector<long long> part(steps.size(),0);
+            std::vector<std::pair<unsigned int,unsigned int> > turns;  //(step, node of rs_trees[i] it goes through)
+            #pragma omp for schedule(dynamic,16)
+            for (unsigned int j=b; j<e; ++j) {
+                const unsigned int i = order[j].second;
+                aw::Tree &g_tree = g_trees[i];
+                const RestrictedTree &t = rs_trees[i];
+                const long long w = in.g_fixed[i];
+                turns.clear();
+                for (unsigned int a=0,aEE=t.node.size(); a<aEE; ++a)
+                    if(!t.tip[a] && t.counts(a))
+                        for (unsigned int s=through_first[t.node[a]],sEE=through_first[t.node[a]+1]; s<sEE; ++s)
+                            turns.push_back(std::make_pair(through[s],a));
+                std::sort(turns.begin(),turns.end());
+                //the pruned subtree moves from edge {a,b} to edge {b,c}: the classes of both
+                //edges give the supported nodes that change
+                unsigned int c = start[i];
+                for (unsigned int ti=0,tiEE=turns.size(); ti<tiEE; ++ti) {
+                    const RegraftStep &st = steps[turns[ti].first];
+                    const unsigned int a = turns[ti].second;
+                    const unsigned int from = t.position(in,st.a,st.b), to = t.position(in,st.b,st.c);
+                    if(from!=c) ERROR_exit("Wrong move-down");
+                    unsigned int f1, f2, t1, t2;
+                    t.items(a,from,f1,f2); t.items(a,to,t1,t2);
+                    const int d = take_support(g_tree,f1) + take_support(g_tree,f2) + give_support(g_tree,t1) + give_support(g_tree,t2);
+                    part[turns[ti].first] += d*w;
+                    c = to;
+                }
+            }
+            #pragma omp critical
+            for (unsigned int si=0,siEE=steps.size(); si<siEE; ++si) delta[si] += part[si];
+        }
+    }
+
+    // swap the input tree state with the caller's (no copying for a single worker)
+    public: inline void swap(std::vector<aw::Tree> &g, std::vector<aw::RootedLCA> &l) {
+        g_trees.swap(g); g_lca.swap(l);
+    }
+
+    // root the input trees by the leaves of root_at as evaluate does (NONODE: not affected)
+    public: inline void root_inputs(const std::vector<unsigned int> &root_at) {
+        #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+        for (unsigned int k=0; k<g_trees.size(); ++k)
+            if(root_at[k]!=NONODE && !g_trees[k].is_adjacent(0,root_at[k])) {
+                reroot_gene(g_trees[k],root_at[k]);
+                g_lca[k].update_root(g_trees[k]); }
+    }
+
+    // score every position of the move-down of m; a supertree is kept in found
+    // only if it scores below bound, which is lowered to the best score seen
+    public: inline void evaluate(SPRInput &in, SPRMove &m, const std::vector<unsigned int> &root_at,
+            float &bound, std::vector<SPRCandidate> &found) {
+        aw::Tree &us_tree = m.us_tree;
+        const unsigned int rgft_side = m.rgft_side, reg_leaf = m.reg_leaf;
+        const unsigned int reg_leaf_adj = regraft_start(m);
+
+        treeEft.clear();
+        std::vector<unsigned int> eft_trees;   //affected trees, each thread gets a fixed slice of them
+        //candidates after the first position are met on the supertree rooted like the first
+        //affected tree, also if its score changes are not computed
+        unsigned int first_eft = NONODE;
+        for (unsigned int k=0,kEEE=g_trees.size(); k<kEEE; ++k) {
+            if(root_at[k]!=NONODE && first_eft==NONODE) first_eft = k;
+            treeEft.push_back(root_at[k]!=NONODE && !in.g_fold[k]);
+            if(treeEft[k]) eft_trees.push_back(k);
+        }
+        rs_trees.resize(g_trees.size()); start.resize(g_trees.size());
+
+        //rooting g_tree by the leaf s_tree is rooted by for it
+        root_inputs(root_at);
+        unsigned int root = NONODE, root_adj = NONODE;
+        if(first_eft!=NONODE) root_edge(in,us_tree,first_eft,root_at[first_eft],root,root_adj);
+
+        std::vector<unsigned int> g_score(g_trees.size()), gain(g_trees.size(),0);
+        #pragma omp parallel for schedule(dynamic,4) if(par::worth(eft_trees.size(),2))
+        for (unsigned int j=0; j<eft_trees.size(); ++j){
+            const unsigned int k = eft_trees[j];
+            unsigned int r, r_adj;
+            root_edge(in,us_tree,k,root_at[k],r,r_adj);
+            g_score[k] = restrict_to(in,m,k,r,reg_leaf_adj);
+            gain[k] = best_gain(k);
+        }
+        //exact sum once per prune edge, then the move-down adds the changes of the affected trees
+        long long total = 0;
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+            if(!treeEft[i]) g_score[i] = in.g_scr[i];
+            total += g_score[i]*in.g_fixed[i];
+        }
+        float score = fixed_score(total);
+
+        //rooting us_tree for iteration
+        us_tree.addRoot(reg_leaf,rgft_side);  //root it for traversal
+        unsigned int pos = 0;
+        if(score < bound) {
+            found.push_back(SPRCandidate());
+            found.back().score = score; found.back().pos = pos;
+            found.back().root = found.back().root_adj = NONODE;
+            bound = score; }
+        //*************************     Starting MOVE-DOWN thing     **************************************************************************************
+        //the positions first, and the steps through each node; then all of them for one
+        //affected tree at a time. The changes of a position are summed over the trees in
+        //fixed point, which gives the same total in any order.
+        steps.clear();
+        {   MoveDown md(in,m,reg_leaf_adj);
+            RegraftStep st;
+            while(md.next(st.a,st.b,st.c)) steps.push_back(st);
+        }
+        delta.assign(steps.size(),0);
+        through_first.assign(us_tree.node_size()+1,0);
+        BOOST_FOREACH(const RegraftStep &st, steps) ++through_first[st.b+1];
+        for (unsigned int v=0,vEE=us_tree.node_size(); v<vEE; ++v) through_first[v+1] += through_first[v];
+        through.resize(steps.size());
+        {   std::vector<unsigned int> next(through_first.begin(),through_first.end()-1);
+            for (unsigned int si=0,siEE=steps.size(); si<siEE; ++si) through[next[steps[si].b]++] = si;
+        }
+
+        //trees that can gain most first: once the best position so far together with the
+        //gains of the trees left cannot score below bound, the rest is not evaluated. The
+        //batches between these checks double in size, so the checks cost little.
+        std::vector<std::pair<long long,unsigned int> > order;
+        long long rest = 0;     //weights are not negative (see tree_IO.h), so rest only shrinks
+        BOOST_FOREACH(const unsigned int &k, eft_trees) {
+            order.push_back(std::make_pair(-(long long)gain[k]*in.g_fixed[k],k));
+            rest += gain[k]*in.g_fixed[k];
+        }
+        std::sort(order.begin(),order.end());
+        for (unsigned int b=0,e=std::min<unsigned int>(1,order.size()); b<order.size(); b=e, e=std::min<unsigned int>(2*e,order.size())) {
+            if(!steps.empty()) {
+                long long at = 0, lowest = delta[0];
+                for (unsigned int si=0,siEE=steps.size(); si<siEE; ++si) {
+                    at += delta[si];
+                    if(at<lowest) lowest = at; }
+                const float best_case = fixed_score(total+lowest-rest);
+                if(best_case >= bound) return;
+            }
+            add_changes(in,order,b,e);
+            for (unsigned int j=b; j<e; ++j) rest += order[j].first;
+        }
+
+        for (unsigned int si=0,siEE=steps.size(); si<siEE; ++si) {
+            ++pos;
+            total += delta[si];
+            score = fixed_score(total);
+
+            if(score < bound) {
+                if(first_eft!=NONODE) {
+                    found.push_back(SPRCandidate());
+                    found.back().score = score; found.back().pos = pos;
+                    found.back().root = root; found.back().root_adj = root_adj; }
+                bound = score; }
+        }
+    }
+};
+
+// Prefilter of the prune edges of a round by gene duplications: only the prune edges
+// whose best regraft position lowers the duplication score most are scored exactly.
+// Duplications need binary input trees and a rooted binary species tree with one leaf
+// per taxon, so input trees with polytomies or without a root are left out, the copies
+// of a taxon are stood for by their fake node and the supertree keeps its root of the
+// round. Every input tree counts with its own root and weight: trees the search folds
+// into one have the same unrooted topology, not the same duplications. A filtered
+// round without improvement is completed by a round that scores the prune edges it
+// left out.
+class DupFilter {
+    protected: unsigned int k;                          //prune edges scored exactly per round, 0 if off
+    protected: std::vector<aw::Tree> g_trees;           //binary input trees as given
+    protected: std::vector<long long> g_weights;        //their weights in fixed point
+    protected: std::vector<aw::g_tree_stride> g_strides;
+    protected: std::vector<aw::LCAmapping> g_lmaps;
+    protected: std::vector<std::vector<std::pair<unsigned int,unsigned int> > > g_leaves;   //(leaf, global id)
+    protected: aw::Tree s_reduced;                      //supertree of the round, copies taken off
+    protected: aw::LCA s_lca;
+    protected: std::vector<unsigned int> s_node;        //node of s_reduced of each global id
+    protected: std::vector<unsigned int> s_order, s_parent, s_pre, s_end;  //preorder of s_reduced: v and its subtree at s_pre[v] to s_end[v]-1
+    protected: std::vector<long long> dups_inc, dups_dec, above;
+    protected: std::vector<unsigned int> g_lmap2;       //mappings of the gene nodes without the moved subtree
+    protected: std::vector<char> g_mixed;               //gene nodes with leaves on both sides of the moved subtree
+    protected: std::vector<char> flags;                 //over spr_order: prune edges scored exactly; empty if all
+    protected: std::set<boost::dynamic_bitset<> > scored;   //pruned taxa of the prune edges scored exactly
+    protected: bool complete;                           //the round completes one without improvement
+
+    public: DupFilter() : k(0), complete(false) { }
+
+    // the input trees as given, g_trees_in, that are rooted and binary; k prune edges per round
+    public: inline void create(SPRInput &in, std::vector<aw::Tree> &g_trees_in, const unsigned int k_) {
+        k = k_; complete = false;
+        g_trees.clear(); g_weights.clear(); g_leaves.clear();
+        for (unsigned int i=0,iEE=g_trees_in.size(); i<iEE; ++i) {
+            aw::Tree &t = g_trees_in[i];
+            if(t.degree(0)!=2) continue;
+            bool binary = true;
+            for (unsigned int v=1,vEE=t.node_size(); v<vEE && binary; ++v)
+                binary = t.degree(v)==1 || t.degree(v)==3;
+            if(!binary) continue;
+            g_trees.push_back(t);
+            g_weights.push_back(fixed_weight(in.g_weights[i]));
+            g_leaves.push_back(std::vector<std::pair<unsigned int,unsigned int> >());
+            TREE_FOREACHLEAF(v,t) g_leaves.back().push_back(std::make_pair(v,in.g_nmaps[i].gid(v)));
+        }
+        g_strides.resize(g_trees.size());
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) g_strides[i].create(g_trees[i]);
+        g_lmaps.resize(g_trees.size());
+    }
+
+    // number of input trees used
+    public: inline unsigned int size() const {
+        return g_trees.size();
+    }
+
+    // start of a round: the k prune edges of spr_order with the lowest duplication change
+    // (the earlier one on ties) and those no change is known for are scored exactly, or
+    // after a filtered round without improvement those that round left out
+    public: inline void round(SPRInput &in, const std::vector<chEdge> &spr_edge, const std::vector<std::pair<unsigned int,bool> > &spr_order) {
+        flags.clear();
+        if(k==0 || complete) return;
+        scored.clear();
+        if(spr_order.size()<=k || !reduce(in)) return;
+        std::vector<char> known(s_reduced.node_size(),0);   //1: change of the subtree known, 2: no position
+        std::vector<long long> change(s_reduced.node_size(),0);
+        std::vector<std::pair<long long,unsigned int> > rank;
+        flags.assign(spr_order.size(),1);
+        for (unsigned int qi=0,qiEE=spr_order.size(); qi<qiEE; ++qi) {
+            const unsigned int c = moved_subtree(spr_edge[spr_order[qi].first],spr_order[qi].second);
+            if(c==NONODE) continue;
+            if(!known[c]) known[c] = best_change(c,change[c]) ? 1 : 2;
+            if(known[c]==1) rank.push_back(std::make_pair(change[c],qi));
+        }
+        std::sort(rank.begin(),rank.end());
+        for (unsigned int i=k,iEE=rank.size(); i<iEE; ++i) flags[rank[i].second] = 0;
+    }
+
+    // true if prune edge qi of the round, of the pruned taxa prn, is not scored exactly
+    public: inline bool skip(const unsigned int qi, const boost::dynamic_bitset<> &prn) {
+        if(complete) return scored.count(prn)>0;
+        if(flags.empty()) return false;
+        if(!flags[qi]) return true;
+        scored.insert(prn);
+        return false;
+    }
+
+    // end of a round; true if the round left prune edges out and had no improvement, then
+    // the next round scores those
+    public: inline bool again(const bool improved) {
+        complete = !complete && !flags.empty() && !improved;
+        return complete;
+    }
+
+    // the supertree with the copies of each taxon taken off their fake node, which
+    // becomes the leaf the input tree leaves of the taxon map to; false if it is not binary
+    protected: inline bool reduce(SPRInput &in) {
+        s_reduced = in.s_tree;
+        s_node.assign(in.s_one.size(),NONODE);
+        std::vector<unsigned int> ids;
+        for (unsigned int g=0,gEE=in.s_one.size(); g<gEE; ++g) {
+            ids.clear();
+            in.s_nmap.ids(g,ids);
+            if(ids.empty()) continue;
+            if(ids.size()==1) { s_node[g] = ids[0]; continue; }
+            s_node[g] = s_reduced.adjacent_vector(ids[0])[0];
+            BOOST_FOREACH(const unsigned int &c, ids) s_reduced.remove_edge(s_node[g],c);
+        }
+        if(s_reduced.degree(0)!=2) return false;
+        for (unsigned int v=1,vEE=s_reduced.node_size(); v<vEE; ++v)
+            if(s_reduced.degree(v)>1 && s_reduced.degree(v)!=3) return false;
+        const unsigned int n = s_reduced.node_size();
+        s_order.clear(); s_parent.assign(n,NONODE); s_pre.assign(n,NONODE); s_end.assign(n,NONODE);
+        for (aw::Tree::iterator_dfs v=s_reduced.begin_dfs(),vEE=s_reduced.end_dfs(); v!=vEE; ++v) {
+            if(v.direction==PREORDER) {
+                s_pre[v.idx] = s_order.size();
+                s_order.push_back(v.idx);
+                if(v.idx!=0) s_parent[v.idx] = v.parent;
+            } else if(v.direction==POSTORDER) s_end[v.idx] = s_order.size();
+        }
+        s_lca.create(s_reduced);
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) {
+            for (unsigned int j=0,jEE=g_leaves[i].size(); j<jEE; ++j)
+                g_lmaps[i].set_LCA(g_leaves[i][j].first,s_node[g_leaves[i][j].second]);
+            g_lmaps[i].update_LCA_internals(s_lca,g_trees[i]);
+        }
+        dups_inc.resize(n); dups_dec.resize(n); above.resize(n);
+        return true;
+    }
+
+    // the side of the prune edge of e that is moved: the pruned one if it is a subtree of
+    // s_reduced, else the other one (the same prune edge seen from the root); NONODE if
+    // e is no edge of s_reduced
+    protected: inline unsigned int moved_subtree(const chEdge &e, const bool reg_x) const {
+        const unsigned int l = reg_x ? e.x : e.y, r = reg_x ? e.y : e.x;
+        if(s_parent[l]==r || (s_parent[l]==0 && s_parent[r]==0)) return l;
+        if(s_parent[r]==l) return r;
+        return NONODE;
+    }
+
+    // true if v is in the subtree of u
+    protected: inline bool below(const unsigned int v, const unsigned int u) const {
+        return s_pre[u]<=s_pre[v] && s_pre[v]<s_end[u];
+    }
+
+    // true if v is in the subtree of u and not u
+    protected: inline bool strictly_below(const unsigned int v, const unsigned int u) const {
+        return s_pre[u]<s_pre[v] && s_pre[v]<s_end[u];
+    }
+
+    // lowest change of the weighted duplication score over the positions subtree c of
+    // s_reduced can be regrafted to that give another unrooted supertree; false if there
+    // are none. As in the SPR of Bansal, Eulenstein and Wehe, c is moved to
+    // the root first, its parent p then being the root above c and the rest, but the
+    // LCAs and mappings of that tree come from those of s_reduced.
+    protected: inline bool best_change(const unsigned int c, long long &change) {
+        const unsigned int p = s_parent[c], pp = s_parent[p];
+        unsigned int ch[2]; s_reduced.children(p,pp,ch);
+        const unsigned int s = ch[0]==c ? ch[1] : ch[0];
+        std::fill(dups_inc.begin(),dups_inc.end(),0);
+        std::fill(dups_dec.begin(),dups_dec.end(),0);
+        for (unsigned int i=0,iEE=g_trees.size(); i<iEE; ++i) changes(i,c,p,s,pp);
+        //regraft above v: the changes of the nodes above v in the rest, p has none
+        bool found = false;
+        long long best = 0, at_s = 0;
+        for (unsigned int j=0,jEE=s_order.size(); j<jEE; ++j) {
+            const unsigned int v = s_order[j], u = s_parent[v];
+            if(v==c) { j = s_end[c]-1; continue; }
+            above[v] = u==NONODE ? 0 : above[u]+dups_inc[u]-dups_dec[u];
+            if(v==p) continue;
+            const long long d = above[v]-dups_dec[v];
+            if(v==s) at_s = d;
+            else if(pp!=0 || (v!=0 && u!=0)) {     //above the root and its children is above s
+                if(!found || d<best) best = d;
+                found = true; }
+        }
+        change = best-at_s;
+        return found;
+    }
+
+    // duplication changes of input tree i for the positions of subtree c below p (its
+    // sibling s, p below pp) in the rest; a gene node with leaves in c and in the rest
+    // maps to the root, else as in s_reduced
+    protected: inline void changes(const unsigned int i, const unsigned int c, const unsigned int p, const unsigned int s, const unsigned int pp) {
+        aw::g_tree_stride &g_stride = g_strides[i];
+        aw::LCAmapping &g_lmap = g_lmaps[i];
+        const long long w = g_weights[i];
+        if(g_lmap2.size()<g_stride.node_size()) { g_lmap2.resize(g_stride.node_size()); g_mixed.resize(g_stride.node_size()); }
+        for (unsigned int j=0,jEE=g_stride.size(); j<jEE; ++j) {
+            aw::g_tree_stride::u_node &n = g_stride[j];
+            const unsigned int v_map = g_lmap.mapping(n.node);
+            if(n.direction()==PREORDER) {
+                //only gene nodes mapped above c can have leaves on both sides
+                if(v_map!=NONODE && !strictly_below(c,v_map)) j += n.preorder.skip - 1;
+                continue;
+            }
+            g_mixed[n.node] = 0;
+            if(v_map==NONODE) continue;
+            const unsigned int * const ch = n.postorder.ch;
+            const unsigned int ch_map_0 = g_lmap.mapping(ch[0]), ch_map_1 = g_lmap.mapping(ch[1]);
+            bool case0;
+            if((case0 = ch_map_0==NONODE) || ch_map_1==NONODE) {
+                g_mixed[n.node] = g_mixed[ch[case0 ? 1 : 0]];
+                g_lmap2[n.node] = g_lmap2[ch[case0 ? 1 : 0]];
+                continue;
+            }
+            const bool to_root_0 = strictly_below(c,ch_map_0) && g_mixed[ch[0]];
+            const bool to_root_1 = strictly_below(c,ch_map_1) && g_mixed[ch[1]];
+            const bool in_l_0 = below(ch_map_0,c), in_l_1 = below(ch_map_1,c);
+            if(!to_root_0 && !to_root_1 && !in_l_0 && !in_l_1) continue;     //all leaves in the rest
+            g_mixed[n.node] = 1;
+            //both children map to the root: no duplication lost or gained
+            if(to_root_0 && to_root_1) {
+                g_lmap2[n.node] = s_lca.lca(g_lmap2[ch[0]],g_lmap2[ch[1]]);
+                continue;
+            }
+            const bool in_r_0 = !to_root_0 && !in_l_0, in_r_1 = !to_root_1 && !in_l_1;
+            //one child maps to the root, one into the rest: the duplication is lost below
+            //the lca of their mappings in the rest, unless the latter maps there
+            if((case0 = to_root_0 && in_r_1) || (to_root_1 && in_r_0)) {
+                const unsigned int s_l = g_lmap2[ch[case0 ? 0 : 1]], s_r = case0 ? ch_map_1 : ch_map_0;
+                const unsigned int s_p = g_lmap2[n.node] = s_lca.lca(s_l,s_r);
+                if(s_r==s_p) continue;
+                unsigned int s_pch[2];
+                if(s_p==pp) { s_reduced.children(pp,s_parent[pp],s_pch); s_pch[s_pch[0]==p ? 0 : 1] = s; }
+                else s_reduced.children(s_p,s_parent[s_p],s_pch);
+                if(below(s_l,s_pch[0])) dups_dec[s_pch[0]] += w;
+                else if(below(s_l,s_pch[1])) dups_dec[s_pch[1]] += w;
+                continue;
+            }
+            //one child maps into c, one into the rest: a duplication below the latter
+            if((case0 = in_l_0 && in_r_1) || (in_l_1 && in_r_0)) {
+                const unsigned int v_map2 = case0 ? ch_map_1 : ch_map_0;
+                g_lmap2[n.node] = v_map2;
+                dups_inc[v_map2] += w;
+                continue;
+            }
+            //one child maps to the root, one into c: no duplication lost or gained
+            g_lmap2[n.node] = g_lmap2[ch[to_root_0 ? 0 : 1]];
+        }
+    }
+};
+
+// an improving move of one prune edge, described by leaves so that it can be
+// replayed on a supertree already changed by other moves
+struct SPRLeafMove {
+    float score;
+    std::vector<char> prune;    //flags over node ids: leaves of the pruned subtree
+    std::vector<char> side;     //leaves behind one end of the regraft edge
+};
+
+// moves with lower scores are tried first
+inline bool move_before(const SPRLeafMove &a, const SPRLeafMove &b) {
+    return a.score < b.score;
+}
+
+// unrooted copy of a supertree (node 0 is left without edges)
+inline void unrooted_copy(aw::Tree &t, aw::Tree &u) {
+    u = t;
+    if(u.degree(0)==2) u.delRoot();
+}
+
+// nodes of the unrooted tree t in depth first order from leaf r, with their parents
+inline void dfs_from(aw::Tree &t, const unsigned int r, std::vector<unsigned int> &order, std::vector<unsigned int> &parent) {
+    order.clear(); parent.assign(t.node_size(),NONODE);
+    std::vector<unsigned int> stack(1,r);
+    while(!stack.empty()) {
+        const unsigned int v = stack.back(); stack.pop_back();
+        order.push_back(v);
+        BOOST_FOREACH(const unsigned int &w, t.adjacent(v))
+            if(w!=parent[v]) { parent[w] = v; stack.push_back(w); }
+    }
+}
+
+// edge {n,pn} of the unrooted tree t with exactly the flagged leaves behind n, where
+// leaves flagged in skip are ignored; false if the flagged leaves are no clade of t
+inline bool find_split(aw::Tree &t, const std::vector<char> &in, const std::vector<char> &skip,
+        unsigned int &n, unsigned int &pn) {
+    unsigned int r = NONODE, size = 0;
+    TREE_FOREACHLEAF(v,t) {
+        if(t.degree(v)!=1 || (v<skip.size() && skip[v])) continue;   //single nodes are no leaves here
+        if(v<in.size() && in[v]) ++size;
+        else if(r==NONODE) r = v;
+    }
+    if(r==NONODE || size==0) return false;
+    std::vector<unsigned int> order, parent;
+    dfs_from(t,r,order,parent);
+    std::vector<unsigned int> cnt_in(t.node_size(),0), cnt_all(t.node_size(),0);
+    for (unsigned int i=order.size(); i-->0; ) {
+        const unsigned int v = order[i];
+        if(t.is_leaf(v) && !(v<skip.size() && skip[v])) {
+            ++cnt_all[v];
+            if(v<in.size() && in[v]) ++cnt_in[v]; }
+        if(parent[v]!=NONODE) { cnt_in[parent[v]] += cnt_in[v]; cnt_all[parent[v]] += cnt_all[v]; }
+    }
+    for (unsigned int i=1,iEE=order.size(); i<iEE; ++i) {
+        const unsigned int v = order[i];
+        if(cnt_in[v]==size && cnt_all[v]==size && cnt_all[parent[v]]>size) {
+            n = v; pn = parent[v]; return true; }
+    }
+    return false;
+}
+
+// flags of the leaves behind v when the unrooted tree t is entered from pv
+inline void leaves_behind(aw::Tree &t, const unsigned int v, const unsigned int pv, std::vector<char> &flags) {
+    flags.assign(t.node_size(),0);
+    std::vector<std::pair<unsigned int,unsigned int> > stack(1,std::make_pair(v,pv));
+    while(!stack.empty()) {
+        const std::pair<unsigned int,unsigned int> a = stack.back(); stack.pop_back();
+        if(t.is_leaf(a.first)) flags[a.first] = 1;
+        BOOST_FOREACH(const unsigned int &w, t.adjacent(a.first))
+            if(w!=a.second) stack.push_back(std::make_pair(w,a.first));
+    }
+}
+
+// the pruned leaves of m: its side of the prune edge
+inline void prune_leaves(SPRInput &in, SPRMove &m, std::vector<char> &flags) {
+    flags.assign(in.s_tree.node_size(),0);
+    TREE_FOREACHLEAF(l,in.s_tree)
+        if(pruned_leaf(in,m,l)) flags[l] = 1;
+}
+
+// describe the move that turned the supertree into the tree t of a candidate with score
+inline bool describe_move(aw::Tree &t, const float score, const std::vector<char> &prune, SPRLeafMove &mv) {
+    aw::Tree u; unrooted_copy(t,u);
+    const std::vector<char> none;
+    unsigned int n, pn;
+    if(!find_split(u,prune,none,n,pn)) return false;
+    std::vector<unsigned int> adj;
+    BOOST_FOREACH(const unsigned int &w, u.adjacent(pn)) if(w!=n) adj.push_back(w);
+    if(adj.size()!=2) return false;
+    mv.score = score; mv.prune = prune;
+    leaves_behind(u,adj[0],pn,mv.side);
+    return true;
+}
+
+// replay mv on the unrooted tree u: prune the subtree with its attachment node and
+// regraft it into the edge that splits off the side leaves
+inline bool apply_move(aw::Tree &u, const SPRLeafMove &mv) {
+    const std::vector<char> none;
+    unsigned int n, pn;
+    if(!find_split(u,mv.prune,none,n,pn)) return false;
+    std::vector<unsigned int> adj;
+    BOOST_FOREACH(const unsigned int &w, u.adjacent(pn)) if(w!=n) adj.push_back(w);
+    if(adj.size()!=2 || u.is_fake(pn)) return false;
+    aw::Tree t = u;
+    t.remove_edge(pn,adj[0]); t.remove_edge(pn,adj[1]); t.add_edge(adj[0],adj[1]);
+    std::vector<char> skip = mv.prune; skip.resize(t.node_size(),0); skip[pn] = 1;    //pn is a leaf of the pruned part now
+    unsigned int a, b;
+    if(!find_split(t,mv.side,skip,a,b)) return false;
+    t.remove_edge(a,b); t.add_edge(a,pn); t.add_edge(pn,b);
+    u = t;
+    return true;
+}
+
+// nodes a move changes in the unrooted tree u: the pruned subtree, its attachment
+// node and the path to the regraft edge
+inline bool move_nodes(aw::Tree &u, const SPRLeafMove &mv, std::vector<char> &touched) {
+    const std::vector<char> none;
+    unsigned int n, pn;
+    if(!find_split(u,mv.prune,none,n,pn)) return false;
+    touched.assign(u.node_size(),0);
+    {   std::vector<unsigned int> order, parent;
+        dfs_from(u,pn,order,parent);
+        std::vector<char> below(u.node_size(),0);
+        below[n] = 1;
+        BOOST_FOREACH(const unsigned int &v, order)
+            if(v==n || (parent[v]!=NONODE && below[parent[v]])) { below[v] = 1; touched[v] = 1; }
+        touched[pn] = 1;
+        aw::Tree t = u;
+        std::vector<unsigned int> adj;
+        BOOST_FOREACH(const unsigned int &w, t.adjacent(pn)) if(w!=n) adj.push_back(w);
+        if(adj.size()!=2) return false;
+        t.remove_edge(pn,adj[0]); t.remove_edge(pn,adj[1]); t.add_edge(adj[0],adj[1]);
+        std::vector<char> skip = mv.prune; skip.resize(t.node_size(),0); skip[pn] = 1;
+        unsigned int a, b;
+        if(!find_split(t,mv.side,skip,a,b)) return false;
+        //paths from the attachment node to both ends of the regraft edge
+        for (unsigned int v=a; v!=NONODE; v=parent[v]) touched[v] = 1;
+        for (unsigned int v=b; v!=NONODE; v=parent[v]) touched[v] = 1;
+    }
+    return true;
+}
+
+// apply the moves (best first) whose changed nodes are disjoint from those of the
+// moves taken before; returns the number of moves applied to the rooted result
+inline unsigned int combine_moves(aw::Tree &s_tree, const std::vector<SPRLeafMove> &moves, aw::Tree &out) {
+    aw::Tree u0; unrooted_copy(s_tree,u0);
+    aw::Tree u = u0;
+    std::vector<char> used(u0.node_size(),0);
+    unsigned int applied = 0;
+    BOOST_FOREACH(const SPRLeafMove &mv, moves) {
+        std::vector<char> touched;
+        if(!move_nodes(u0,mv,touched)) continue;
+        bool clash = false;
+        for (unsigned int v=0,vEE=touched.size(); v<vEE && !clash; ++v)
+            clash = touched[v] && used[v];
+        if(clash) continue;
+        if(!apply_move(u,mv)) continue;
+        for (unsigned int v=0,vEE=touched.size(); v<vEE; ++v)
+            if(touched[v]) used[v] = 1;
+        ++applied;
+    }
+    //root again at the pendant edge of a leaf that is not in a star of copies
+    TREE_FOREACHLEAF(v,u) {
+        if(u.degree(v)!=1) continue;
+        const unsigned int a = u.adjacent_vector(v)[0];
+        if(!u.is_fake(a)) { u.addRoot(v,a); break; }
+    }
+    u.root = 0;
+    out = u;
+    return applied;
+}
+
+// score of a supertree computed from scratch for the current rootings of the input trees;
+// the trees induced by the leaf sets of the input trees are those of s_tree afterwards
+inline float supertree_score(SPRInput &in, aw::Tree &s_tree, std::vector<aw::Tree> &g_trees,
+        std::vector<aw::RootedLCA> &g_lca, aw::InducedTrees &induced) {
+    induced.update(s_tree,in.s_nmap);
+    std::vector<unsigned int> g_score(g_trees.size());
+    #pragma omp parallel for schedule(dynamic,16) if(par::worth(g_trees.size(),2))
+    for (unsigned int k=0; k<g_trees.size(); ++k)
+        g_score[k] = induced.rf_score(k,g_trees[k],in.g_nmaps[k],g_lca[k],in.g_nodes[k],in.rs_int_nodes[k]);
+    return weighted_score(g_score,in.g_weights);
+}
+
+} // namespace end
+
+#endif	/* _SPR_SEARCH_H */
@@ -96,7 +96,7 @@ class LCA {
     }
 
     //LCA of two nodes
-    public: inline unsigned int lca(const unsigned int u, const unsigned int v) {
+    public: inline unsigned int lca(const unsigned int u, const unsigned int v) const {
         if(u==NONODE && v==NONODE) return NONODE; //Added by ruchi
         if (u == v) return u;
         if (u == NONODE) return v;
@@ -119,6 +119,37 @@ class LCA {
     }
 };
 
+// LCA queries on a tree rooted by one of its leaves (node 0 next to the leaf), answered
+// from the LCA of the same tree rooted by another leaf. Rerooting only changes the root
+// leaf, so one LCA can be shared read only by every copy of the tree.
+class RootedLCA {
+    protected: const LCA *ref;  // LCA of the tree rooted by its first root leaf
+    protected: unsigned int r;  // current root leaf
+
+    public: RootedLCA() : ref(NULL), r(NONODE) {}
+    public: RootedLCA(const LCA &l) : ref(&l), r(NONODE) {}
+
+    // pick up the root leaf of the tree as it is rooted now
+    public: template<class TREE> inline void update_root(TREE &tree) {
+        r = NONODE;
+        BOOST_FOREACH(const unsigned int &c, tree.adjacent(0))
+            if (tree.degree(c) == 1) r = c;
+    }
+
+    //LCA of two nodes: the median of u, v and the root leaf in the shared LCA
+    public: inline unsigned int lca(const unsigned int u, const unsigned int v) const {
+        if(u==NONODE && v==NONODE) return NONODE;
+        if (u == v) return u;
+        if (u == NONODE) return v;
+        if (v == NONODE) return u;
+        if (u == 0 || v == 0 || u == r || v == r) return 0;
+        const unsigned int a = ref->lca(u,v), b = ref->lca(u,r), c = ref->lca(v,r);
+        if (a == b) return c;
+        if (a == c) return b;
+        return a;
+    }
+};
+
 } // namespace end
 
 #endif
@@ -111,7 +111,7 @@ private: std::vector<unsigned int> _map;
         }
     }
     // update the LCA mapping of a single internal node
-    public: template<class TREE> inline void update_LCA_internal(LCA &s_lca, TREE &g_tree, const unsigned int gene_id, const unsigned int parent) {
+    public: template<class L, class TREE> inline void update_LCA_internal(L &s_lca, TREE &g_tree, const unsigned int gene_id, const unsigned int parent) {
         unsigned int v_map = NONODE;
         //std::cout<<"--gd "<<gene_id<<"--";
         BOOST_FOREACH(const unsigned int &c,g_tree.children(gene_id,parent)) {
@@ -121,11 +121,11 @@ private: std::vector<unsigned int> _map;
         _map[gene_id] = v_map;
     }
     // update the LCA mapping of a single internal node
-    public: inline void update_LCA_internal_binary(LCA &s_lca, const unsigned int gene_id, const unsigned int ch0, const unsigned int ch1) {
+    public: template<class L> inline void update_LCA_internal_binary(L &s_lca, const unsigned int gene_id, const unsigned int ch0, const unsigned int ch1) {
         _map[gene_id] = s_lca.lca(_map[ch0],_map[ch1]);
     }
     // update the LCA mapping of all internal nodes between 2 trees
-    public: template<class TREE> inline void update_LCA_internals(LCA &s_lca, TREE &g_tree) {
+    public: template<class L, class TREE> inline void update_LCA_internals(L &s_lca, TREE &g_tree) {
         if (!g_tree.is_rooted()) ERROR_exit("rooted tree expected"); // LCA mapping for rooted gene trees only
         TREE_POSTORDER2(v,g_tree) {
             if (!g_tree.is_leaf(v.idx)) {
@@ -135,6 +135,14 @@ private: std::vector<unsigned int> _map;
         }
     }
 
+    // update the LCA mapping of the given nodes only, ordered children before parents
+    // (nodes whose subtree changed and their ancestors); all others keep their mapping
+    public: template<class L, class TREE, class PARENTS> inline void update_LCA_internals(L &s_lca, TREE &g_tree, PARENTS &parents, const std::vector<unsigned int> &nodes) {
+        BOOST_FOREACH(const unsigned int &v, nodes)
+            if (!g_tree.is_leaf(v))
+                update_LCA_internal(s_lca, g_tree, v, parents.parent(v));
+    }
+
     // set the LCA mapping for one gene tree node - manually
     public: inline void set_LCA(const unsigned int gene_id, const unsigned int species_id) {
         if (gene_id >= _map.size()) _map.resize(gene_id+1);
@@ -0,0 +1,87 @@
+/*
+ * File:   tree_cluster_index.h
+ * Author: ruchi
+ *
+ * Cluster sizes of a species tree for many input trees at once. The tree is
+ * traversed once; the cluster size of a node for one input tree (the number
+ * of its leaves mapped into that input tree) is a range count over the leaves
+ * in traversal order, so no traversal per input tree is needed. There is no
+ * incremental update: after the tree changes the index is created again, and
+ * count() scans all leaves of the tree for every input tree, O(n) each.
+ */
+
+#ifndef _TREE_CLUSTER_INDEX_H
+#define	_TREE_CLUSTER_INDEX_H
+
+#include "common.h"
+#include "tree.h"
+#include "tree_traversal.h"
+#include "tree_LCA_mapping.h"
+#include <vector>
+
+namespace aw {
+
+// O(n) precomputation per tree, again after every change of the tree
+// O(n) for all cluster sizes of one input tree, flat arrays only
+class ClusterIndex {
+    protected: std::vector<unsigned int> order;     // nodes in preorder
+    protected: std::vector<unsigned int> leaves;    // leaves in traversal order
+    protected: std::vector<unsigned int> first, last;   // range of leaves below each node
+    protected: std::vector<unsigned int> parents;
+    protected: unsigned int root;
+
+    // index the subtree of r (p is the neighbour of r that is left out, or NONODE)
+    public: template<class TREE> inline void create(TREE &t, const unsigned int r, const unsigned int p) {
+        order.clear(); leaves.clear();
+        first.resize(t.node_size()); last.resize(t.node_size()); parents.resize(t.node_size());
+        root = r;
+        for (aw::Tree::iterator_dfs v=t.begin_dfs(r,p),vEE=t.end_dfs(); v!=vEE; ++v) {
+            switch (v.direction) {
+                case PREORDER: {
+                    order.push_back(v.idx);
+                    parents[v.idx] = v.idx==r ? NONODE : v.parent;
+                    first[v.idx] = leaves.size();
+                    if (t.is_leaf(v.idx)) leaves.push_back(v.idx);
+                } break;
+                case POSTORDER: {
+                    last[v.idx] = leaves.size();
+                } break;
+                default: break;
+            }
+        }
+    }
+
+    // the nodes that were indexed
+    public: inline const std::vector<unsigned int> &nodes() const {
+        return order;
+    }
+
+    // cluster sizes cl[v] of the indexed nodes, counting the leaves that are mapped by
+    // map; returns the number of mapped leaves. With leaf r the tree is taken as rooted
+    // by r: the nodes on the path from r up to the root of the index turn around and
+    // their cluster becomes the total minus the old cluster of their neighbour below.
+    public: inline unsigned int count(LCAmapping &map, const unsigned int r, unsigned int *cl) const {
+        std::vector<unsigned int> prefix(leaves.size()+1);
+        prefix[0] = 0;
+        for (unsigned int i=0,iEE=leaves.size(); i<iEE; ++i)
+            prefix[i+1] = prefix[i] + (map.mapping(leaves[i])!=NONODE ? 1 : 0);
+        for (unsigned int i=0,iEE=order.size(); i<iEE; ++i) {
+            const unsigned int v = order[i];
+            cl[v] = prefix[last[v]] - prefix[first[v]];
+        }
+        const unsigned int total = cl[root];
+        if (r == NONODE) return total;
+        if (r == root) cl[r] = map.mapping(r)!=NONODE ? 1 : 0;
+        unsigned int below = cl[r];
+        for (unsigned int v=parents[r]; v!=NONODE; v=parents[v]) {
+            const unsigned int old = cl[v];
+            cl[v] = total - below;
+            below = old;
+        }
+        return total;
+    }
+};
+
+} // namespace end
+
+#endif	/* _TREE_CLUSTER_INDEX_H */
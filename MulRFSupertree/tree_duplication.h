@@ -21,6 +21,7 @@
 #include "tree_name_map.h"
 #include "tree_LCA_mapping.h"
 #include "tree_subtree_info.h"
+#include "tree_cluster_index.h"
 #include <limits.h>
 #include <boost/random.hpp>
 
@@ -105,6 +106,18 @@ class TreeClusters {
         }
     }
 
+    // same as above, from the traversal of st shared by all input trees
+    public: inline void create(tree_type &st, tree_type &gt, aw::TreetaxaMap &gmap, aw::TreetaxaMap &smap, aw::LCAmapping &map, const ClusterIndex &idx) {
+        free();
+        g_tree_ptr = &gt;
+        s_tree_ptr = &st;
+        s_nmap = &smap;
+        g_nmap = &gmap;
+        node_size = st.node_size();
+        clusters = new unsigned int[node_size];
+        idx.count(map,NONODE,clusters);
+    }
+
     public: inline void stPtrUpdate(tree_type &st) {
         s_tree_ptr = &st;
     }
@@ -301,6 +314,17 @@ inline unsigned int compute_rf_score(TREE &s_tree, TREE &g_tree, LCAmapping &s_m
     return 0;
 }
 
+// the part of the RF score above (WITH TREECLUSTER) that node v with parent pv adds
+template<class TREE>
+inline unsigned int rf_score_node(TREE &s_tree, TREE &g_tree, LCAmapping &s_map, TreeClusters<aw::Tree> &sclst, const unsigned int v, const unsigned int pv) {
+    if(s_tree.is_leaf(v) || s_tree.root==v) return 0;
+    int ct = 0;
+    BOOST_FOREACH(const unsigned int &c, s_tree.children(v,pv))
+        if(s_map.mapping(c)!=NONODE) ++ct;
+    if(ct<2) return 0;
+    return sclst.cluster(v) != g_tree.return_clstSz(s_map.mapping(v)) ? 2 : 0;
+}
+
 // compute the gene duplications induced by multiple gene trees
 template<class TREE>
 inline unsigned int compute_duplications(std::vector<TREE> &g_trees, std::vector<LCAmapping> &g_maps) {
@@ -355,20 +379,16 @@ inline unsigned int compute_duplications(STREE &s_tree, idx2name &s_names, std::
     return dups;
 }
 
-#ifndef AW_RANDOMGEN
-boost::mt19937 rng;
-#endif
-
 // find the best SPR move on the subtree - there can be multiple equal ones, then only one of them is returned
 // return
 //   location = edge(u,v) for the location with lowest duplications
 //   duplications = lowest duplications
-// not thread-safe
+// equal ones are chosen with rng; not thread-safe
 template<class STREE,class GTREE>
 bool bestSPRlocation(
     const unsigned int subtree, const unsigned int subtree_parent, STREE &s_tree,
     std::vector<GTREE> &g_trees, std::vector<aw::LCAmapping> &g_lmaps,
-    std::pair<unsigned int, unsigned int> &location, unsigned int &duplications
+    std::pair<unsigned int, unsigned int> &location, unsigned int &duplications, boost::mt19937 &rng
 ) {
     const unsigned int &subtree_left = subtree;
     const unsigned int current_root = s_tree.root;
@@ -531,7 +551,7 @@ bool bestSPRlocation(
                 }
             }
             boost::uniform_int<> range(0,candidates.size()-1);
-            boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(aw::rng, range);
+            boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(rng, range);
             location = candidates[die()];
             candidates.clear();
         }
@@ -653,6 +673,139 @@ inline bool REVmove2edge_binary(TREE &t, const unsigned int subtree, const unsig
     return true;
 }
 
+// a step of moving a subtree through a tree: down into the edge {v,pv} or back up
+// from it into the edge {pv,ppv}
+struct EdgeMove {
+    unsigned int v, pv, ppv;
+    bool down;
+};
+
+// redo the first n steps of log on the tree they were made on
+template<class TREE>
+inline void replay_moves(TREE &t, const unsigned int subtree, const unsigned int parent, const std::vector<EdgeMove> &log, const unsigned int n) {
+    for (unsigned int i=0; i<n; ++i)
+        if(log[i].down) move2edge_binary(t,subtree,parent,log[i].v,log[i].pv);
+        else REVmove2edge_binary(t,subtree,parent,log[i].v,log[i].pv,log[i].ppv);
+}
+
+// a step of a depth first traversal
+struct DfsStep {
+    unsigned int idx, parent;
+    aw::traversal_states direction;
+};
+
+// the steps of a depth first traversal of the subtree of v (p is left out), so that
+// they can be walked while the tree is changed
+template<class TREE>
+inline void dfs_steps(TREE &t, const unsigned int v, const unsigned int p, std::vector<DfsStep> &steps) {
+    steps.clear();
+    for (aw::Tree::iterator_dfs m=t.begin_dfs(v,p),mEE=t.end_dfs(); m!=mEE; ++m) {
+        DfsStep s; s.idx = m.idx; s.parent = m.parent; s.direction = m.direction;
+        steps.push_back(s);
+    }
+}
+
+// the score terms of the two nodes one step of a move-down of an inserted leaf changes
+// for one input tree: the parent p of the leaf (par) and the node the step passes (pm)
+struct InsertTerms {
+    unsigned int step, tree;
+    unsigned char par_old, pm_old, par_new, pm_new;
+};
+
+// Scores of all positions of a new leaf c (a star of its copies in a MUL tree) with parent
+// p in the subtree of below_p: the steps of the move-down and, per step, the terms of the
+// input trees with c that are not zero. A term is not zero only next to a node with leaves
+// of the input tree below it, so an input tree adds work for the nodes above its leaves
+// only. Terms of a step are kept in input tree order, so sums over them do not depend on
+// how they were found.
+class LeafInsertion {
+    public: std::vector<unsigned int> first;    //terms of step s: terms[first[s]] to terms[first[s+1]]
+    public: std::vector<InsertTerms> terms;
+    protected: std::vector<unsigned int> pre_at, post_at, stamp, nodes, ids;
+    protected: unsigned int cur;
+    protected: std::vector<std::vector<InsertTerms> > found;
+
+    public: LeafInsertion() : cur(0) { }
+
+    // term of the parent p of the new leaf when p is above v: p has v and c below, its
+    // cluster and mapping are those of v with c (lc leaves of the input tree mapped to l)
+    protected: template<class TREE, class LCA>
+    static inline unsigned int with_c(TREE &g_tree, TreeClusters<aw::Tree> &cl, LCAmapping &lm, LCA &lca,
+            const unsigned int v, const unsigned int lc, const unsigned int l) {
+        return cl.cluster(v)+lc != g_tree.return_clstSz(lca.lca(lm.mapping(v),l)) ? 2 : 0;
+    }
+
+    // the steps are those of a traversal of the subtree of below_p, entered from p; the
+    // scores are those of the input trees listed in has
+    public: template<class TREE, class PARENTS, class NMAP, class LCA>
+    inline void create(TREE &s_tree, PARENTS &s_parent, const std::vector<DfsStep> &steps, const unsigned int p,
+            const unsigned int c, const unsigned int below_p, const std::vector<unsigned int> &has,
+            std::vector<TREE> &g_trees, std::vector<NMAP> &g_nmaps, NMAP &s_nmap, std::vector<LCAmapping> &s_lmaps,
+            std::vector<TreeClusters<aw::Tree> > &s_clst, std::vector<LCA> &g_lca) {
+        pre_at.assign(s_tree.node_size(),NONODE); post_at.assign(s_tree.node_size(),NONODE);
+        for (unsigned int i=0,iEE=steps.size(); i<iEE; ++i)
+            (steps[i].direction==aw::PREORDER ? pre_at : post_at)[steps[i].idx] = i;
+        if(stamp.size()<s_tree.node_size()) stamp.resize(s_tree.node_size(),0);
+        const bool top = s_tree.root==p;   //below_p is the root while p is below it
+        found.resize(has.size());
+        const unsigned int base = cur;
+        cur += has.size();
+
+        for (unsigned int j=0,jEE=has.size(); j<jEE; ++j) {
+            const unsigned int k = has[j], mark = base+j+1;
+            TREE &g_tree = g_trees[k];
+            LCAmapping &lm = s_lmaps[k];
+            TreeClusters<aw::Tree> &cl = s_clst[k];
+            const unsigned int l = lm.mapping(c), lc = cl.cluster(c);
+            std::vector<InsertTerms> &out = found[j];
+            out.clear();
+
+            //nodes of the subtree with leaves of the input tree below them
+            nodes.clear();
+            TREE_FOREACHLEAF(w,g_tree) {
+                ids.clear();
+                s_nmap.ids(g_nmaps[k].gid(w),ids);
+                BOOST_FOREACH(const unsigned int &v, ids) {
+                    if(v==c || lm.mapping(v)==NONODE) continue;
+                    for (unsigned int u=v; u!=NONODE && pre_at[u]!=NONODE && stamp[u]!=mark; u=s_parent.parent(u)) {
+                        stamp[u] = mark;
+                        nodes.push_back(u);
+                        if(u==below_p) break;
+                    }
+                }
+            }
+
+            BOOST_FOREACH(const unsigned int &mp, nodes) {
+                if(s_tree.is_leaf(mp) || s_tree.is_fake(mp)) continue;
+                const unsigned int own = compute_rf_score(s_tree,g_tree,lm,mp,s_parent.parent(mp),cl);
+                const unsigned int p_mp = (top && mp==below_p) ? 0 : with_c(g_tree,cl,lm,g_lca[k],mp,lc,l);
+                BOOST_FOREACH(const unsigned int &mi, s_tree.children(mp,s_parent.parent(mp))) {
+                    const unsigned int p_mi = lm.mapping(mi)!=NONODE ? with_c(g_tree,cl,lm,g_lca[k],mi,lc,l) : 0;
+                    //mp above p: p is its child instead of mi, it has the cluster of p before
+                    const unsigned int sib = s_parent.sibling_binary(mi);
+                    const unsigned int with = ((top && mp==below_p) || lm.mapping(sib)==NONODE) ? 0 : p_mp;
+                    if(p_mp+own+p_mi+with==0) continue;
+                    InsertTerms t; t.tree = k;
+                    t.step = pre_at[mi]; t.par_old = p_mp; t.pm_old = own; t.par_new = p_mi; t.pm_new = with;
+                    out.push_back(t);
+                    t.step = post_at[mi]; t.par_old = p_mi; t.pm_old = with; t.par_new = p_mp; t.pm_new = own;
+                    out.push_back(t);
+                }
+            }
+        }
+
+        //terms by step, in input tree order within a step
+        first.assign(steps.size()+1,0);
+        for (unsigned int j=0,jEE=has.size(); j<jEE; ++j)
+            BOOST_FOREACH(const InsertTerms &t, found[j]) ++first[t.step+1];
+        for (unsigned int i=0,iEE=steps.size(); i<iEE; ++i) first[i+1] += first[i];
+        terms.resize(first[steps.size()]);
+        std::vector<unsigned int> at(first.begin(),first.end()-1);
+        for (unsigned int j=0,jEE=has.size(); j<jEE; ++j)
+            BOOST_FOREACH(const InsertTerms &t, found[j]) terms[at[t.step]++] = t;
+    }
+};
+
 
 
 
@@ -709,268 +862,6 @@ class g_tree_stride {
     }
 };
 
-// compute the gene duplcation changes for an SPR-down operation
-// input:
-//   s_tree - species tree where SPR-subtree is at root
-//   s_parent - parents of species nodes
-//   s_lca - LCAs of species nodes
-//   subtree_left - prune subtree_left
-//   subtree_right - regraft into subtree
-//   parent - parent of subtree_left and subtree_right
-//   g_stride - preordered gene tree nodes
-//   g_lmap - gene tree LCA mapping
-// output:
-//   dups_inc - duplication increasment @ node; initialized to 0
-//   dups_dec - duplication deccreasment @ node; initialized to 0
-template<class STREE>
-void compute_dupchanges4SPR(STREE &s_tree, SubtreeParent<aw::Tree> &s_parent, LCA &s_lca,
-                            const unsigned int parent, const unsigned int subtree_left, const unsigned int subtree_right,
-                            g_tree_stride &g_stride, LCAmapping &g_lmap,
-                            util::vector<unsigned int> &dups_inc, util::vector<unsigned int> &dups_dec
-) {
-    // Bansal, Eulenstein, Wehe algorithm to determine best SPR
-    static util::vector<unsigned int> g_lmap2;
-    g_lmap2.set_min_size(g_stride.node_size());
-    for (unsigned int j=0,jEE=g_stride.size(); j<jEE; ++j) {
-        aw::g_tree_stride::u_node &n = g_stride[j];
-        switch (n.direction()) {
-            case aw::PREORDER: {
-                const unsigned int &v_map = g_lmap.mapping(n.node);
-                if (v_map == NONODE) break;
-                if (v_map != parent) { // no need to traverse further into the subtree
-                    j += n.preorder.skip - 1;
-                }
-            } break;
-            case aw::POSTORDER: {
-                const unsigned int &v_map = g_lmap.mapping(n.node);
-                if (v_map == NONODE) break;
-                if (v_map == parent) {
-                    const unsigned int * const ch = n.postorder.ch;
-                    const unsigned int &ch_map_0 = g_lmap.mapping(ch[0]);
-                    const unsigned int &ch_map_1 = g_lmap.mapping(ch[1]);
-                    bool case0;
-                    // missing lca mapping, usually caused by missing taxa in the species tree
-                    // no gene duplications will ever be lost or gained
-                    if ((case0 = ch_map_0 == aw::NONODE) || (ch_map_1 == aw::NONODE)) {
-                        g_lmap2[n.node] = g_lmap2[ch[case0 ? 1 : 0]];
-                        break;
-                    }
-                    const bool to_root_0 = (ch_map_0 == parent);
-                    const bool to_root_1 = (ch_map_1 == parent);
-                    // parent and both children map to the root
-                    // no gene duplications will every be lost or gained
-                    if (to_root_0 && to_root_1) {
-                        const unsigned int &ch_map2_0 = g_lmap2[ch[0]];
-                        const unsigned int &ch_map2_1 = g_lmap2[ch[1]];
-                        const unsigned int v_map2 = s_lca.lca(ch_map2_0,ch_map2_1);
-                        g_lmap2[n.node] = v_map2;
-                        break;
-                    }
-                    const bool in_r_0 = s_lca.lca(ch_map_0,subtree_right) == subtree_right;
-                    const bool in_r_1 = s_lca.lca(ch_map_1,subtree_right) == subtree_right;
-                    // parent and one child map to the root, one child maps into the right subtree
-                    if ((case0 = to_root_0 && in_r_1) || (to_root_1 && in_r_0)) {
-                        const unsigned int &ch_map2_0 = case0 ? g_lmap2[ch[0]] : ch_map_0;
-                        const unsigned int &ch_map2_1 = case0 ? ch_map_1 : g_lmap2[ch[1]];
-                        const unsigned int &s_l = case0 ? ch_map2_0 : ch_map2_1; // virtually maps to the right subtree
-                        const unsigned int &s_r = case0 ? ch_map2_1 : ch_map2_0; // maps to the right subtree
-                        const unsigned int &s_p = g_lmap2[n.node] = s_lca.lca(ch_map2_0,ch_map2_1); // virtually maps to the lca of both child mappings
-                        const unsigned int &s_pp = s_parent.parent(s_p); // parent of s_p
-                        unsigned int s_pch[2]; s_tree.children(s_p, s_pp, s_pch); // children of s_p
-                        if (s_r == s_p) { // duplication remains because of the right child mapping
-                        } else
-                        if (s_lca.lca(s_l,s_pch[0]) == s_pch[0]) {
-                            const unsigned int &s_ll = s_pch[0]; // left child of s_p
-                            ++dups_dec[s_ll];
-                        } else
-                        if (s_lca.lca(s_l,s_pch[1]) == s_pch[1]) {
-                            const unsigned int &s_ll = s_pch[1]; // left child of s_p
-                            ++dups_dec[s_ll];
-                        }
-                        break;
-                    }
-                    const bool in_l_0 = s_lca.lca(ch_map_0,subtree_left) == subtree_left;
-                    const bool in_l_1 = s_lca.lca(ch_map_1,subtree_left) == subtree_left;
-                    // parent maps to the root, one child maps into the left subtree, one child maps into the right subtree
-                    // then gene duplication occurs when moving below the mapped node in the right subtree
-                    if ((case0 = in_l_0 && in_r_1) || (in_l_1 && in_r_0)) {
-                        const unsigned int &v_map2 = case0 ? ch_map_1 : ch_map_0;
-                        g_lmap2[n.node] = v_map2;
-                        ++dups_inc[v_map2];
-                        break;
-                    }
-                    // parent and one child map to the root, one child maps into the left subtree
-                    // then no gene duplications will every be lost
-                    if ((case0 = to_root_0 && in_l_1) || (to_root_1 && in_l_0)) {
-                        const unsigned int &v_map2 = g_lmap2[ch[case0 ? 0 : 1]];
-                        g_lmap2[n.node] = v_map2;
-                        break;
-                    }
-                    // something is wrong
-                    ERROR_exit("something is wrong");
-                }
-            } break;
-            default: break;
-        }
-    }
-}
-
-// accumulate gene duplication changes and compute the gene duplication score for the SPR moves
-// input:
-//   s_tree - species tree where SPR-subtree is at root
-//   subtree,parent - (right)-subtree with possible regrafting edges
-//   dups - current gene duplication score when SPR-subtree is at root
-//   dups_inc - duplication increasment @ node
-//   dups_dec - duplication decreasment @ node
-// output:
-//   new_location - SPR-edge for lowest gene duplications
-//   dups - gene duplications when SPR is moved to new_location
-//   ambiguity - number of locations with same lowest gene duplications
-//   dups_inc dups_dec - will be reset to 0 for used entries
-template<class STREE>
-inline void accumulate_dup_changes(STREE &s_tree, const unsigned int subtree, const unsigned int parent,
-                                   util::vector<unsigned int> &dups_inc, util::vector<unsigned int> &dups_dec,
-                                   std::pair<unsigned int, unsigned int> &new_location, unsigned int &dups, unsigned int &ambiguity
-) {
-    unsigned int d = dups;
-    typedef std::pair<unsigned int,unsigned int> candidates_item;
-    static util::vector<candidates_item> candidates;
-    candidates.set_min_size(s_tree.node_size());
-    for (typename STREE::iterator_dfs v=s_tree.begin_dfs(subtree,parent),vEE=s_tree.end_dfs(); v!=vEE; ++v) {
-        switch (v.direction) {
-            case aw::PREORDER: {
-                d -= dups_dec[v.idx];
-                if (d < dups) {
-                    dups = d;
-                    candidates.clear();
-                }
-                if (d == dups) {
-                    candidates.push_back(std::pair<unsigned int,unsigned int>(v.idx,v.parent));
-                }
-                d += dups_inc[v.idx];
-            } break;
-            case aw::POSTORDER: {
-                d -= dups_inc[v.idx];
-                d += dups_dec[v.idx];
-                dups_inc[v.idx] = 0;
-                dups_dec[v.idx] = 0;
-            } break;
-            default: break;
-        }
-    }
-    ambiguity = candidates.size();
-// P(candidates.size()-1);
-    boost::uniform_int<> range(0,candidates.size()-1);
-    boost::variate_generator<boost::mt19937&, boost::uniform_int<> > die(aw::rng, range);
-    new_location = candidates[die()];
-    candidates.clear();
-}
-
 } // namespace end
 
-// compute the gene duplcation changes for an SPR-down operation
-// input:
-//   s_tree - species tree where SPR-subtree is at root
-//   s_parent - parents of species nodes
-//   s_lca - LCAs of species nodes
-//   subtree_left - prune subtree_left
-//   subtree_right - regraft into subtree
-//   parent - parent of subtree_left and subtree_right
-//   g_stride - preordered gene tree nodes
-//   g_lmap - gene tree LCA mapping
-// output:
-//   dups_inc - duplication increasment @ node; initialized to 0
-//   dups_dec - duplication deccreasment @ node; initialized to 0
-template<class STREE>
-void compute_dupchanges4SPR_singletaxon(STREE &s_tree, aw::SubtreeParent<aw::Tree> &s_parent, aw::LCA &s_lca,
-                            const unsigned int parent, const unsigned int subtree_left, const unsigned int subtree_right,
-                            aw::g_tree_stride &g_stride, aw::LCAmapping &g_lmap,
-                            util::vector<unsigned int> &dups_inc, util::vector<unsigned int> &dups_dec
-) {
-    // Bansal, Eulenstein, Wehe algorithm to determine best SPR
-    static util::vector<unsigned int> g_lmap2; g_lmap2.set_min_size(g_stride.node_size());
-    for (unsigned int j=0,jEE=g_stride.size(); j<jEE; ++j) {
-        aw::g_tree_stride::u_node &n = g_stride[j];
-        switch (n.direction()) {
-            case aw::PREORDER: {
-                const unsigned int &v_map = g_lmap.mapping(n.node);
-                if (v_map == aw::NONODE) break;
-                if (v_map != parent) { // no need to traverse further into the subtree
-                    j += n.preorder.skip - 1;
-                }
-            } break;
-            case aw::POSTORDER: {
-                const unsigned int &v_map = g_lmap.mapping(n.node);
-                if (v_map == aw::NONODE) break;
-                if (v_map == parent) {
-                    const unsigned int * const ch = n.postorder.ch;
-                    const unsigned int &ch_map_0 = g_lmap.mapping(ch[0]);
-                    const unsigned int &ch_map_1 = g_lmap.mapping(ch[1]);
-                    bool case0;
-                    // missing lca mapping, usually caused by missing taxa in the species tree
-                    // no gene duplications will ever be lost or gained
-                    if ((case0 = ch_map_0 == aw::NONODE) || (ch_map_1 == aw::NONODE)) {
-                        g_lmap2[n.node] = g_lmap2[ch[case0 ? 1 : 0]];
-                        break;
-                    }
-                    const bool to_root_0 = (ch_map_0 == parent);
-                    const bool to_root_1 = (ch_map_1 == parent);
-                    // parent and both children map to the root
-                    // no gene duplications will every be lost or gained
-                    if (to_root_0 && to_root_1) {
-                        const unsigned int &ch_map2_0 = g_lmap2[ch[0]];
-                        const unsigned int &ch_map2_1 = g_lmap2[ch[1]];
-                        const unsigned int v_map2 = s_lca.lca(ch_map2_0,ch_map2_1);
-                        g_lmap2[n.node] = v_map2;
-                        break;
-                    }
-                    const bool in_r_0 = s_lca.lca(ch_map_0,subtree_right) == subtree_right;
-                    const bool in_r_1 = s_lca.lca(ch_map_1,subtree_right) == subtree_right;
-                    // parent and one child map to the root, one child maps into the right subtree
-                    if ((case0 = to_root_0 && in_r_1) || (to_root_1 && in_r_0)) {
-                        const unsigned int &ch_map2_0 = case0 ? g_lmap2[ch[0]] : ch_map_0;
-                        const unsigned int &ch_map2_1 = case0 ? ch_map_1 : g_lmap2[ch[1]];
-                        const unsigned int &s_l = case0 ? ch_map2_0 : ch_map2_1; // virtually maps to the right subtree
-                        const unsigned int &s_r = case0 ? ch_map2_1 : ch_map2_0; // maps to the right subtree
-                        const unsigned int &s_p = g_lmap2[n.node] = s_lca.lca(ch_map2_0,ch_map2_1); // virtually maps to the lca of both child mappings
-                        const unsigned int &s_pp = s_parent.parent(s_p); // parent of s_p
-                        unsigned int s_pch[2]; s_tree.children(s_p, s_pp, s_pch); // children of s_p
-                        if (s_r == s_p) { // duplication remains because of the right child mapping
-                        } else
-                        if (s_lca.lca(s_l,s_pch[0]) == s_pch[0]) {
-                            const unsigned int &s_ll = s_pch[0]; // left child of s_p
-                            ++dups_dec[s_ll];
-                        } else
-                        if (s_lca.lca(s_l,s_pch[1]) == s_pch[1]) {
-                            const unsigned int &s_ll = s_pch[1]; // left child of s_p
-                            ++dups_dec[s_ll];
-                        }
-                        break;
-                    }
-                    const bool in_l_0 = s_lca.lca(ch_map_0,subtree_left) == subtree_left;
-                    const bool in_l_1 = s_lca.lca(ch_map_1,subtree_left) == subtree_left;
-                    // parent maps to the root, one child maps into the left subtree, one child maps into the right subtree
-                    // then gene duplication occurs when moving below the mapped node in the right subtree
-                    if ((case0 = in_l_0 && in_r_1) || (in_l_1 && in_r_0)) {
-                        const unsigned int &v_map2 = case0 ? ch_map_1 : ch_map_0;
-                        g_lmap2[n.node] = v_map2;
-                        ++dups_inc[v_map2];
-                        break;
-                    }
-                    // parent and one child map to the root, one child maps into the left subtree
-                    // then no gene duplications will every be lost
-                    if ((case0 = to_root_0 && in_l_1) || (to_root_1 && in_l_0)) {
-                        const unsigned int &v_map2 = g_lmap2[ch[case0 ? 0 : 1]];
-                        g_lmap2[n.node] = v_map2;
-                        break;
-                    }
-                    // something is wrong
-                    ERROR_exit("something is wrong");
-                }
-            } break;
-            default: break;
-        }
-    }
-}
-
 #endif
@@ -0,0 +1,278 @@
+/*
+ * File:   tree_induced.h
+ * Author: ruchi
+ *
+ * The species tree restricted to the taxa of an input tree. The RF score of an
+ * input tree only depends on the species leaves it maps to, so it is computed
+ * on the tree these leaves induce (their LCA closure, nodes left with a single
+ * child are dropped) instead of on a rooted copy of the whole species tree.
+ * Input trees with the same taxa and copy counts share one induced tree.
+ * A taxon with several copies in the input tree is one leaf with that many
+ * copies: the fake node above the copies in the species tree and the copies
+ * themselves are left out, as its cluster and mapping follow from the copies.
+ * Input trees with up to 128 leaves are scored with their clusters as bit masks
+ * over their own leaves: a node of the input tree is supported if a node of the
+ * induced tree has the same leaves below it, which is a hash set lookup.
+ */
+
+#ifndef _TREE_INDUCED_H
+#define	_TREE_INDUCED_H
+
+#include "common.h"
+#include "tree.h"
+#include "tree_traversal.h"
+#include "tree_LCA.h"
+#include "tree_name_map.h"
+#include "parallel.h"
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_set.hpp>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+namespace aw {
+
+// the species tree restricted to a leaf set: leaf v of t stands for mult[v] copies of
+// the taxon gid[v]
+struct InducedTree {
+    aw::Tree t;
+    std::vector<unsigned int> gid, mult;
+};
+
+// leaves of an input tree as a bit mask of W words; leaf i is bit i
+template<unsigned int W> struct LeafMask {
+    boost::uint64_t w[W];
+
+    LeafMask() { for (unsigned int i=0; i<W; ++i) w[i] = 0; }
+    inline void set(const unsigned int i) { w[i>>6] |= (boost::uint64_t)1 << (i&63); }
+    inline LeafMask &operator|=(const LeafMask &r) {
+        for (unsigned int i=0; i<W; ++i) w[i] |= r.w[i];
+        return *this; }
+    inline bool operator==(const LeafMask &r) const {
+        for (unsigned int i=0; i<W; ++i) if(w[i]!=r.w[i]) return false;
+        return true; }
+    inline bool empty() const {
+        for (unsigned int i=0; i<W; ++i) if(w[i]) return false;
+        return true; }
+};
+
+template<unsigned int W> inline std::size_t hash_value(const LeafMask<W> &m) {
+    std::size_t h = 0;
+    for (unsigned int i=0; i<W; ++i) boost::hash_combine(h,m.w[i]);
+    return h;
+}
+
+// O(n) per species tree and O(m log m) per leaf set of m leaves
+// O(m) per RF score of an input tree with m leaves
+class InducedTrees {
+    protected: std::vector<std::vector<unsigned int> > sets;    // taxa and copy counts of each leaf set
+    protected: std::vector<unsigned int> set_of;               // leaf set of each input tree
+    protected: std::vector<InducedTree> trees;
+    protected: std::vector<unsigned int> pre;                  // preorder number of the species nodes
+    protected: aw::LCA s_lca;
+
+    // group the input trees by their taxa
+    public: inline void create(std::vector<TreetaxaMap> &g_nmaps) {
+        std::map<std::vector<unsigned int>, unsigned int> known;
+        sets.clear();
+        set_of.resize(g_nmaps.size());
+        for (unsigned int k=0,kEE=g_nmaps.size(); k<kEE; ++k) {
+            std::set<unsigned int> gids;
+            g_nmaps[k].unq_gids(gids);
+            std::vector<unsigned int> key;
+            BOOST_FOREACH(const unsigned int &gid, gids) {
+                key.push_back(gid);
+                key.push_back(g_nmaps[k].ids_count(gid)); }
+            std::map<std::vector<unsigned int>, unsigned int>::iterator i = known.find(key);
+            if (i == known.end()) {
+                i = known.insert(std::make_pair(key,(unsigned int)sets.size())).first;
+                sets.push_back(key); }
+            set_of[k] = i->second;
+        }
+        trees.clear();
+        trees.resize(sets.size());
+    }
+
+    // number of distinct leaf sets
+    public: inline unsigned int size() const {
+        return sets.size();
+    }
+
+    // induce all leaf sets from the species tree s_tree as it is now
+    public: template<class TREE> inline void update(TREE &s_tree, TreetaxaMap &s_nmap) {
+        pre.assign(s_tree.node_size(),NONODE);
+        unsigned int n = 0;
+        TREE_PREORDER2(v,s_tree) pre[v.idx] = n++;
+        s_lca.create(s_tree);
+        #pragma omp parallel for schedule(dynamic,16) if(par::worth(trees.size(),2))
+        for (unsigned int i=0; i<trees.size(); ++i) induce(s_nmap,i);
+    }
+
+    // leaf set i: one species leaf per taxon (its copies hang below one fake node) and the
+    // LCAs of these leaves in preorder; a node is the child of the last node before it
+    // that is its ancestor
+    protected: inline void induce(TreetaxaMap &s_nmap, const unsigned int i) {
+        const std::vector<unsigned int> &key = sets[i];
+        std::vector<std::pair<unsigned int,unsigned int> > leaves, nodes;   // (preorder number, node)
+        std::vector<unsigned int> l_gid, l_mult, s_ids;
+        for (unsigned int j=0,jEE=key.size(); j<jEE; j+=2) {
+            s_ids.clear();
+            s_nmap.ids(key[j],s_ids);
+            if (s_ids.empty()) continue;
+            leaves.push_back(std::make_pair(pre[s_ids[0]],(unsigned int)l_gid.size()));
+            nodes.push_back(std::make_pair(pre[s_ids[0]],s_ids[0]));
+            l_gid.push_back(key[j]); l_mult.push_back(std::min<unsigned int>(key[j+1],s_ids.size()));
+        }
+        std::sort(leaves.begin(),leaves.end());
+        std::sort(nodes.begin(),nodes.end());
+        for (unsigned int j=1,jEE=nodes.size(); j<jEE; ++j) {
+            const unsigned int a = s_lca.lca(nodes[j-1].second,nodes[j].second);
+            nodes.push_back(std::make_pair(pre[a],a));
+        }
+        std::sort(nodes.begin(),nodes.end());
+        nodes.erase(std::unique(nodes.begin(),nodes.end()),nodes.end());
+
+        InducedTree &it = trees[i];
+        it.t.clear();
+        it.gid.assign(nodes.size(),NONODE); it.mult.assign(nodes.size(),0);
+        std::vector<unsigned int> stack;    // indices into nodes
+        for (unsigned int j=0,l=0,jEE=nodes.size(); j<jEE; ++j) {
+            it.t.new_node();
+            if (l<leaves.size() && leaves[l].first==nodes[j].first) {
+                it.gid[j] = l_gid[leaves[l].second]; it.mult[j] = l_mult[leaves[l].second];
+                ++l; }
+            while (!stack.empty() && s_lca.lca(nodes[stack.back()].second,nodes[j].second)!=nodes[stack.back()].second)
+                stack.pop_back();
+            if (!stack.empty()) it.t.add_edge(stack.back(),j);
+            stack.push_back(j);
+        }
+    }
+
+    // RF score of input tree k as compute_rf_score gives it for the species tree rooted by
+    // the leaf of the root leaf of the input tree: the nodes of the rooted species tree with
+    // a cluster of the input tree are those of the induced tree rooted by the same leaf, and
+    // the fake nodes of taxa with copies. The first copies of a taxon in both trees pair up.
+    // node_count is (internal nodes, leaves) of the input tree; trees with up to 128 leaves
+    // are scored with bit masks.
+    public: template<class TREE, class L> inline unsigned int rf_score(const unsigned int k, TREE &g_tree, TreetaxaMap &g_nmap,
+            L &g_lca, std::pair<unsigned int,unsigned int> &node_count, unsigned int s_int) {
+        if (node_count.second<=64) return rf_score_masks<1>(k,g_tree,g_nmap,node_count,s_int);
+        if (node_count.second<=128) return rf_score_masks<2>(k,g_tree,g_nmap,node_count,s_int);
+        return rf_score_lca(k,g_tree,g_nmap,g_lca,node_count,s_int);
+    }
+
+    // root leaf of input tree k and the leaf of the induced tree with its taxon (NONODE if none)
+    protected: template<class TREE> inline unsigned int root_leaf(const unsigned int k, TREE &g_tree, TreetaxaMap &g_nmap,
+            unsigned int &r) {
+        InducedTree &it = trees[set_of[k]];
+        std::vector<unsigned int> ch;
+        g_tree.adjacent(0,ch);
+        const unsigned int g_rt = g_tree.is_leaf(ch[0]) ? ch[0] : ch[1];
+        r = NONODE;
+        for (unsigned int v=0,vEE=it.t.node_size(); v<vEE && r==NONODE; ++v)
+            if (it.gid[v]==g_nmap.gid(g_rt)) r = v;
+        return g_rt;
+    }
+
+    // the score above with LCA mappings: the LCA of the leaves of a node of the induced tree
+    // has as many leaves below it as that node if it has the same cluster
+    protected: template<class TREE, class L> inline unsigned int rf_score_lca(const unsigned int k, TREE &g_tree, TreetaxaMap &g_nmap,
+            L &g_lca, std::pair<unsigned int,unsigned int> &node_count, unsigned int s_int) {
+        InducedTree &it = trees[set_of[k]];
+        aw::Tree &t = it.t;
+        TREE_FOREACHNODE(v,g_tree) g_tree.init_score(v);
+
+        std::vector<unsigned int> ids;
+        unsigned int r;
+        const unsigned int g_rt = root_leaf(k,g_tree,g_nmap,r);
+
+        if (r != NONODE) {
+            std::vector<unsigned int> cl(t.node_size(),0), map(t.node_size(),NONODE);
+            for (aw::Tree::iterator_dfs v=t.begin_dfs(r,NONODE),vEE=t.end_dfs(); v!=vEE; ++v) {
+                if (v.direction!=POSTORDER) continue;
+                unsigned int count = 0, g = NONODE;
+                if (t.is_leaf(v.idx)) {     //the fake node above the copies
+                    ids.clear();
+                    g_nmap.ids(it.gid[v.idx],ids);
+                    for (unsigned int c=0; c<it.mult[v.idx]; ++c)
+                        if (v.idx!=r || ids[c]!=g_rt) {
+                            ++count;
+                            g = g_lca.lca(g,ids[c]); }
+                    if (v.idx==r)           //rooted by one copy, the fake node is above the rest
+                        BOOST_FOREACH(const unsigned int &c, t.adjacent(r)) {
+                            count += cl[c];
+                            g = g_lca.lca(g,map[c]); }
+                    else {
+                        cl[v.idx] = count; map[v.idx] = g; }
+                    if (it.mult[v.idx]<2) continue;
+                } else {
+                    BOOST_FOREACH(const unsigned int &c, t.children(v.idx,v.parent)) {
+                        count += cl[c];
+                        g = g_lca.lca(g,map[c]); }
+                    cl[v.idx] = count; map[v.idx] = g;
+                }
+                if (g!=NONODE && count==g_tree.return_clstSz(g))
+                    g_tree.incr_score(g,1);
+            }
+        }
+
+        unsigned int score = 0;
+        TREE_FOREACHNODE(v,g_tree)
+            if (!g_tree.is_leaf(v) && g_tree.root!=v && g_tree.return_score(v)==0)
+                score = score + 2;
+        score = score + s_int - node_count.first;
+        return score;
+    }
+
+    // the score above with the clusters of both trees as masks over the leaves of the input
+    // tree (W words of 64 bits are enough for them)
+    protected: template<unsigned int W, class TREE> inline unsigned int rf_score_masks(const unsigned int k, TREE &g_tree,
+            TreetaxaMap &g_nmap, std::pair<unsigned int,unsigned int> &node_count, unsigned int s_int) {
+        InducedTree &it = trees[set_of[k]];
+        aw::Tree &t = it.t;
+
+        //clusters of the internal nodes of the input tree but its root
+        std::vector<LeafMask<W> > g_mask(g_tree.node_size());
+        boost::unordered_set<LeafMask<W> > clusters;
+        unsigned int n = 0;
+        TREE_POSTORDER2(v,g_tree) {
+            if (g_tree.is_leaf(v.idx)) { g_mask[v.idx].set(n++); continue; }
+            BOOST_FOREACH(const unsigned int &c, g_tree.children(v.idx,v.parent)) g_mask[v.idx] |= g_mask[c];
+            if (v.idx!=g_tree.root) clusters.insert(g_mask[v.idx]);
+        }
+        const unsigned int g_int = clusters.size();
+
+        std::vector<unsigned int> ids;
+        unsigned int r;
+        const unsigned int g_rt = root_leaf(k,g_tree,g_nmap,r);
+        unsigned int supported = 0;
+        if (r != NONODE) {
+            std::vector<LeafMask<W> > mask(t.node_size());
+            for (aw::Tree::iterator_dfs v=t.begin_dfs(r,NONODE),vEE=t.end_dfs(); v!=vEE; ++v) {
+                if (v.direction!=POSTORDER) continue;
+                LeafMask<W> m;
+                if (t.is_leaf(v.idx)) {     //the fake node above the copies
+                    ids.clear();
+                    g_nmap.ids(it.gid[v.idx],ids);
+                    for (unsigned int c=0; c<it.mult[v.idx]; ++c)
+                        if (v.idx!=r || ids[c]!=g_rt) m |= g_mask[ids[c]];
+                    if (v.idx==r)           //rooted by one copy, the fake node is above the rest
+                        BOOST_FOREACH(const unsigned int &c, t.adjacent(r)) m |= mask[c];
+                    else mask[v.idx] = m;
+                    if (it.mult[v.idx]<2) continue;
+                } else {
+                    BOOST_FOREACH(const unsigned int &c, t.children(v.idx,v.parent)) m |= mask[c];
+                    mask[v.idx] = m;
+                }
+                if (!m.empty() && clusters.erase(m)) ++supported;
+            }
+        }
+        return 2*(g_int-supported) + s_int - node_count.first;
+    }
+};
+
+} // namespace end
+
+#endif	/* _TREE_INDUCED_H */